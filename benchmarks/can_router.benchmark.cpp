@@ -0,0 +1,349 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-canrouter/can_replay.hpp>
+#include <libhal-canrouter/can_router.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <libhal/can.hpp>
+
+#include "helpers.hpp"
+
+namespace hal {
+namespace {
+enum class router_kind : std::uint8_t
+{
+  linear,
+  indexed,
+  standard_table,
+  hot_cache,
+  filtered,
+};
+
+enum class distribution : std::uint8_t
+{
+  uniform,
+  zipf,
+  hot_five,
+  mostly_miss,
+};
+
+struct scenario
+{
+  router_kind kind;
+  std::size_t route_count;
+  distribution traffic;
+  bool extended;
+};
+
+constexpr std::size_t max_routes = 512;
+constexpr std::size_t hot_cache_lines = 8;
+constexpr std::size_t traffic_length = 4096;
+constexpr std::size_t frames_per_scenario = 1'000'000;
+constexpr double zipf_exponent = 1.0;
+constexpr double miss_ratio = 0.9;
+constexpr std::size_t hot_route_count = 5;
+constexpr double hot_ratio = 0.8;
+
+const char* to_string(router_kind p_kind)
+{
+  switch (p_kind) {
+    case router_kind::linear:
+      return "linear";
+    case router_kind::indexed:
+      return "indexed";
+    case router_kind::standard_table:
+      return "std-table";
+    case router_kind::hot_cache:
+      return "hot-cache";
+    case router_kind::filtered:
+      return "filtered";
+  }
+  return "";
+}
+
+const char* to_string(distribution p_traffic)
+{
+  switch (p_traffic) {
+    case distribution::uniform:
+      return "uniform";
+    case distribution::zipf:
+      return "zipf";
+    case distribution::hot_five:
+      return "hot-five";
+    case distribution::mostly_miss:
+      return "mostly-miss";
+  }
+  return "";
+}
+
+/**
+ * @brief ID of the route at p_position
+ *
+ * Standard IDs are spread over the whole 11-bit space. Extended IDs are spread
+ * over the 29-bit space. In both cases, `id + 1` is never routed.
+ */
+hal::can::id_t route_id(std::size_t p_position, bool p_extended)
+{
+  auto const position = static_cast<hal::can::id_t>(p_position);
+  if (p_extended) {
+    return (0x0100'0000U + (position * 0x0001'0003U * 2)) & 0x1FFF'FFFEU;
+  }
+  return position * 4;
+}
+
+std::vector<hal::can::message_t> make_traffic(const scenario& p_scenario)
+{
+  std::mt19937 engine(0xCA11'0001U);
+  std::vector<double> weights(p_scenario.route_count);
+  for (std::size_t i = 0; i < weights.size(); i++) {
+    weights[i] = p_scenario.traffic == distribution::zipf
+                   ? 1.0 / std::pow(static_cast<double>(i + 1), zipf_exponent)
+                   : 1.0;
+  }
+  std::discrete_distribution<std::size_t> pick_route(weights.begin(),
+                                                     weights.end());
+  std::bernoulli_distribution miss(miss_ratio);
+  std::bernoulli_distribution hot(hot_ratio);
+  std::uniform_int_distribution<std::size_t> pick_hot(
+    0, std::min(hot_route_count, p_scenario.route_count) - 1);
+
+  std::vector<hal::can::message_t> traffic(traffic_length);
+  for (auto& message : traffic) {
+    auto const position = p_scenario.traffic == distribution::hot_five &&
+                              hot(engine)
+                            ? pick_hot(engine)
+                            : pick_route(engine);
+    auto id = route_id(position, p_scenario.extended);
+    if (p_scenario.traffic == distribution::mostly_miss && miss(engine)) {
+      id++;
+    }
+    message = hal::can::message_t{ .id = id, .length = 8 };
+  }
+  return traffic;
+}
+
+void run(const scenario& p_scenario)
+{
+  mock_can mock;
+  std::array<can_router::index_entry, max_routes> index_storage{};
+  can_router::standard_id_table standard_table{};
+  std::array<can_router::hot_route, hot_cache_lines> hot_routes{};
+  can_router::id_filter id_filter{};
+  std::optional<can_router> router;
+
+  switch (p_scenario.kind) {
+    case router_kind::linear:
+      router.emplace(mock);
+      break;
+    case router_kind::indexed:
+      router.emplace(mock, index_storage);
+      break;
+    case router_kind::standard_table:
+      router.emplace(mock, index_storage, standard_table);
+      break;
+    case router_kind::hot_cache:
+      router.emplace(mock, index_storage);
+      router->cache_hot_routes(hot_routes);
+      break;
+    case router_kind::filtered:
+      router.emplace(mock);
+      router->filter_unrouted(&id_filter);
+      break;
+  }
+
+  std::uint32_t volatile sink = 0;
+  std::vector<can_router::route_item> routes;
+  routes.reserve(p_scenario.route_count);
+  for (std::size_t i = 0; i < p_scenario.route_count; i++) {
+    routes.push_back(router->add_message_callback(
+      route_id(i, p_scenario.extended),
+      [&sink](const can::message_t& p_message) {
+        sink = sink + p_message.payload[0];
+      }));
+  }
+
+  auto const traffic = make_traffic(p_scenario);
+  auto& receive = mock.m_handler;
+
+  // Warm up the caches and branch predictors before timing
+  for (auto const& message : traffic) {
+    receive(message);
+  }
+
+  std::size_t frames = 0;
+  auto const start = std::chrono::steady_clock::now();
+  while (frames < frames_per_scenario) {
+    for (auto const& message : traffic) {
+      receive(message);
+    }
+    frames += traffic.size();
+  }
+  auto const elapsed = std::chrono::steady_clock::now() - start;
+
+  auto const nanoseconds =
+    std::chrono::duration<double, std::nano>(elapsed).count();
+  auto const ns_per_frame = nanoseconds / static_cast<double>(frames);
+
+  std::printf("%-10s %6zu  %-12s %-9s %10.2f %14.0f\n",
+              to_string(p_scenario.kind),
+              p_scenario.route_count,
+              to_string(p_scenario.traffic),
+              p_scenario.extended ? "extended" : "standard",
+              ns_per_frame,
+              1e9 / ns_per_frame);
+}
+/**
+ * @brief Time dispatch of a recorded candump log
+ *
+ * Every ID in the log gets an exact route on an indexed router, and the log
+ * is replayed as fast as possible until frames_per_scenario frames have been
+ * dispatched.
+ */
+int run_capture(const char* p_path)
+{
+  std::ifstream file(p_path);
+  if (not file) {
+    std::fprintf(stderr, "cannot open %s\n", p_path);
+    return 1;
+  }
+  std::vector<can_capture::record> records;
+  for (std::string line; std::getline(file, line);) {
+    if (auto const record = parse_candump(line)) {
+      records.push_back(*record);
+    }
+  }
+  if (records.empty()) {
+    std::fprintf(stderr, "no frames in %s\n", p_path);
+    return 1;
+  }
+
+  mock_can mock;
+  std::array<can_router::index_entry, max_routes> index_storage{};
+  can_router router(mock, index_storage);
+  std::uint32_t volatile sink = 0;
+  std::vector<hal::can::id_t> ids;
+  std::vector<can_router::route_item> routes;
+  routes.reserve(max_routes);
+  for (auto const& record : records) {
+    if (routes.size() == max_routes ||
+        std::find(ids.begin(), ids.end(), record.id) != ids.end()) {
+      continue;
+    }
+    ids.push_back(record.id);
+    routes.push_back(router.add_message_callback(
+      record.id, [&sink](const can::message_t& p_message) {
+        sink = sink + p_message.payload[0];
+      }));
+  }
+
+  // Frames from other buses are delivered to the only bus of the router
+  for (auto& record : records) {
+    record.bus = 0;
+  }
+
+  can_replay replay(router);
+  replay.play(records, can_replay::candump_frequency);
+
+  std::size_t frames = 0;
+  auto const start = std::chrono::steady_clock::now();
+  while (frames < frames_per_scenario) {
+    frames += replay.play(records, can_replay::candump_frequency);
+  }
+  auto const elapsed = std::chrono::steady_clock::now() - start;
+
+  auto const nanoseconds =
+    std::chrono::duration<double, std::nano>(elapsed).count();
+  auto const ns_per_frame = nanoseconds / static_cast<double>(frames);
+  std::printf("%-10s %6s  %-12s %-9s %10s %14s\n",
+              "router",
+              "routes",
+              "traffic",
+              "frames",
+              "ns/frame",
+              "frames/sec");
+  std::printf("%-10s %6zu  %-12s %9zu %10.2f %14.0f\n",
+              "indexed",
+              routes.size(),
+              "capture",
+              records.size(),
+              ns_per_frame,
+              1e9 / ns_per_frame);
+  return 0;
+}
+}  // namespace
+}  // namespace hal
+
+int main(int argc, char** argv)
+{
+  // A candump log given on the command line is benchmarked instead of the
+  // synthetic scenarios
+  if (argc > 1) {
+    return hal::run_capture(argv[1]);
+  }
+
+  using hal::distribution;
+  using hal::router_kind;
+
+  constexpr std::array route_counts{ std::size_t{ 1 },   std::size_t{ 8 },
+                                     std::size_t{ 32 },  std::size_t{ 128 },
+                                     std::size_t{ 512 } };
+  constexpr std::array kinds{ router_kind::linear,
+                              router_kind::indexed,
+                              router_kind::standard_table,
+                              router_kind::hot_cache,
+                              router_kind::filtered };
+  constexpr std::array distributions{ distribution::uniform,
+                                      distribution::zipf,
+                                      distribution::hot_five,
+                                      distribution::mostly_miss };
+
+  std::printf("%-10s %6s  %-12s %-9s %10s %14s\n",
+              "router",
+              "routes",
+              "traffic",
+              "ids",
+              "ns/frame",
+              "frames/sec");
+
+  for (auto const kind : kinds) {
+    for (auto const extended : { false, true }) {
+      for (auto const route_count : route_counts) {
+        for (auto const traffic : distributions) {
+          hal::run(hal::scenario{
+            .kind = kind,
+            .route_count = route_count,
+            .traffic = traffic,
+            .extended = extended,
+          });
+        }
+      }
+    }
+  }
+
+  return 0;
+}
@@ -13,6 +13,7 @@
 # limitations under the License.
 
 from conan import ConanFile
+from conan.tools.cmake import CMake
 
 
 required_conan_version = ">=2.0.14"
@@ -25,6 +26,12 @@ class libhal_canrouter_conan(ConanFile):
     description = ("A collection of drivers for the can router")
     topics = ("can", "canrouter", "libhal", "driver")
     settings = "compiler", "build_type", "os", "arch"
+    options = {
+        "instrumentation": [True, False],
+    }
+    default_options = {
+        "instrumentation": False,
+    }
 
     python_requires = "libhal-bootstrap/[^1.0.0]"
     python_requires_extend = "libhal-bootstrap.library"
@@ -33,6 +40,18 @@ class libhal_canrouter_conan(ConanFile):
         bootstrap = self.python_requires["libhal-bootstrap"]
         bootstrap.module.add_library_requirements(self)
 
+    def build(self):
+        instrumentation = bool(self.options.instrumentation)
+        cmake = CMake(self)
+        cmake.configure(variables={
+            "LIBHAL_CANROUTER_INSTRUMENTATION": instrumentation,
+        })
+        cmake.build()
+
     def package_info(self):
         self.cpp_info.libs = ["libhal-canrouter"]
         self.cpp_info.set_property("cmake_target_name", "libhal::canrouter")
+        # Instrumentation changes the layout of can_router, so consumers must
+        # be built with it too
+        if self.options.instrumentation:
+            self.cpp_info.defines = ["LIBHAL_CANROUTER_INSTRUMENTATION=1"]
@@ -0,0 +1,164 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include <libhal/can.hpp>
+#include <libhal/steady_clock.hpp>
+#include <libhal/units.hpp>
+
+#include "can_frame.hpp"
+#include "can_placement.hpp"
+
+namespace hal {
+/**
+ * @brief Lock free ring of timestamped messages received by a router
+ *
+ * Set with can_router::capture(), the router appends every message it
+ * receives, whether or not a route matches it. Each record is 20 bytes, so
+ * the capture can stay enabled in the field and be drained over a debug link
+ * with read(). Records are laid out in the host's byte order and can be
+ * written out as is for can_replay.
+ *
+ * The router is the ring's producer and read() is its consumer. When the ring
+ * is full, new messages are dropped and counted as overflows, so the oldest
+ * records are kept until they are read.
+ *
+ * Records only hold classic messages. CAN FD frames are not recorded and are
+ * counted as skipped instead.
+ */
+class can_capture
+{
+public:
+  /// One captured message
+  struct record
+  {
+    /// Uptime of the capture's clock, truncated to 32 bits. Only the
+    /// difference between two records is meaningful.
+    std::uint32_t timestamp = 0;
+    hal::can::id_t id = 0;
+    std::array<hal::byte, 8> payload{};
+    std::uint8_t length = 0;
+    /// Bus of the router the message was received on
+    std::uint8_t bus = 0;
+    bool is_remote_request = false;
+
+    /**
+     * @return can::message_t - the captured message
+     */
+    [[nodiscard]] can::message_t message() const
+    {
+      return {
+        .id = id,
+        .payload = payload,
+        .length = length,
+        .is_remote_request = is_remote_request,
+      };
+    }
+  };
+
+  /**
+   * @brief Construct a new capture
+   *
+   * @param p_clock - clock to timestamp messages with. Must outlive the
+   * capture.
+   * @param p_storage - storage for the records. Must outlive the capture.
+   * @throws hal::argument_out_of_domain - if p_storage is empty
+   */
+  can_capture(hal::steady_clock& p_clock, std::span<record> p_storage);
+
+  can_capture(can_capture& p_other) = delete;
+  can_capture& operator=(can_capture& p_other) = delete;
+
+  /**
+   * @brief Append a message to the ring
+   *
+   * Called by the router from the receive handler. Must only be called from
+   * the producer context.
+   *
+   * @param p_bus - bus the message was received on
+   * @param p_message - message to record
+   * @return true - if the message was recorded
+   * @return false - if the ring was full and the message was dropped
+   */
+  bool append(std::uint8_t p_bus, const can::message_t& p_message);
+
+  /**
+   * @brief Append a frame to the ring
+   *
+   * Called by the router from can_router::dispatch(). Classic frames are
+   * recorded as by the other overload. Must only be called from the producer
+   * context.
+   *
+   * @param p_bus - bus the frame was received on
+   * @param p_frame - frame to record
+   * @return true - if the frame was recorded
+   * @return false - if the ring was full, or the frame was a CAN FD frame and
+   * was skipped
+   */
+  bool append(std::uint8_t p_bus, const can_frame& p_frame);
+
+  /**
+   * @brief Remove the oldest records from the ring
+   *
+   * Must only be called from the consumer context.
+   *
+   * @param p_records - destination for the records
+   * @return std::size_t - number of records copied into p_records
+   */
+  std::size_t read(std::span<record> p_records);
+
+  /**
+   * @return hal::hertz - frequency of the record timestamps
+   */
+  [[nodiscard]] hal::hertz frequency();
+
+  /**
+   * @return std::size_t - number of records waiting to be read
+   */
+  [[nodiscard]] std::size_t size() const;
+
+  /**
+   * @return std::size_t - maximum number of records the ring holds
+   */
+  [[nodiscard]] std::size_t capacity() const;
+
+  /**
+   * @return std::uint32_t - number of messages dropped because the ring was
+   * full
+   */
+  [[nodiscard]] std::uint32_t overflow_count() const;
+
+  /**
+   * @return std::uint32_t - number of CAN FD frames skipped because records
+   * only hold classic messages
+   */
+  [[nodiscard]] std::uint32_t skipped_count() const;
+
+private:
+  hal::steady_clock* m_clock;
+  std::span<record> m_storage;
+  // Positions run over twice the capacity, see ring_position
+  std::atomic<std::size_t> m_write = 0;
+  std::atomic<std::size_t> m_read = 0;
+  std::atomic<std::uint32_t> m_overflow_count = 0;
+  std::atomic<std::uint32_t> m_skipped_count = 0;
+};
+}  // namespace hal
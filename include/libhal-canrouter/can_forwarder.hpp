@@ -0,0 +1,130 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+
+#include <libhal/can.hpp>
+#include <libhal/steady_clock.hpp>
+#include <libhal/units.hpp>
+
+#include "can_placement.hpp"
+
+namespace hal {
+/**
+ * @brief Forwards received messages to another bus
+ *
+ * Meant for gateways. Registering a forwarder as a route, for example with
+ * `can_router::add_forward()`, sends every message matching the route to the
+ * destination bus from the receive handler, without a user callback. Messages
+ * are sent as received unless an ID rewrite is set, in which case a copy with
+ * the new ID is sent.
+ *
+ * One forwarder may be registered for any number of routes, all of which then
+ * share its rewrite and its rate limit.
+ */
+class can_forwarder
+{
+public:
+  /**
+   * @brief Transform of the ID of forwarded messages
+   *
+   * A forwarded message has the ID `(id & keep) | set`. The defaults keep the
+   * ID unchanged.
+   */
+  struct id_rewrite
+  {
+    /// Bits of the received ID that are kept
+    hal::can::id_t keep = 0xFFFF'FFFF;
+    /// Bits set in the forwarded ID
+    hal::can::id_t set = 0;
+  };
+
+  /**
+   * @brief Construct a forwarder that keeps message IDs unchanged
+   *
+   * @param p_destination - bus to send forwarded messages on. Must outlive the
+   * forwarder.
+   */
+  explicit can_forwarder(hal::can& p_destination);
+
+  /**
+   * @brief Construct a forwarder that rewrites message IDs
+   *
+   * @param p_destination - bus to send forwarded messages on. Must outlive the
+   * forwarder.
+   * @param p_rewrite - transform of the ID of forwarded messages
+   */
+  can_forwarder(hal::can& p_destination, id_rewrite p_rewrite);
+
+  can_forwarder(can_forwarder& p_other) = delete;
+  can_forwarder& operator=(can_forwarder& p_other) = delete;
+
+  /**
+   * @brief Limit how often messages are forwarded
+   *
+   * Messages received sooner than p_min_interval after the last forwarded
+   * message are suppressed and counted. A message the destination rejects
+   * does not count as forwarded.
+   *
+   * @param p_clock - clock to measure the interval with, or nullptr to forward
+   * every message. Must outlive the forwarder or be replaced before it is
+   * destroyed.
+   * @param p_min_interval - shortest time between two forwarded messages
+   */
+  void limit_rate(hal::steady_clock* p_clock,
+                  hal::time_duration p_min_interval);
+
+  /**
+   * @brief Forward a message to the destination bus
+   *
+   * A message that the destination rejects, for example because its transmit
+   * mailboxes are full, is dropped and counted rather than letting the error
+   * unwind through the receive handler.
+   *
+   * @param p_message - message to forward
+   */
+  void operator()(const can::message_t& p_message);
+
+  /**
+   * @return std::uint32_t - number of messages sent on the destination bus.
+   * Wraps on overflow.
+   */
+  [[nodiscard]] std::uint32_t forwarded_count() const;
+
+  /**
+   * @return std::uint32_t - number of messages not forwarded due to the rate
+   * limit. Wraps on overflow.
+   */
+  [[nodiscard]] std::uint32_t suppressed_count() const;
+
+  /**
+   * @return std::uint32_t - number of messages the destination bus failed to
+   * send. Wraps on overflow.
+   */
+  [[nodiscard]] std::uint32_t dropped_count() const;
+
+private:
+  hal::can* m_destination = nullptr;
+  id_rewrite m_rewrite{};
+  hal::steady_clock* m_clock = nullptr;
+  std::uint64_t m_min_interval = 0;
+  std::uint64_t m_last_forwarded = 0;
+  std::uint32_t m_forwarded_count = 0;
+  std::uint32_t m_suppressed_count = 0;
+  std::uint32_t m_dropped_count = 0;
+  bool m_rate_started = false;
+};
+}  // namespace hal
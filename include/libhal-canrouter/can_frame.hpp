@@ -0,0 +1,88 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <span>
+
+#include <libhal/can.hpp>
+#include <libhal/functional.hpp>
+
+namespace hal {
+/// Longest payload of a CAN FD frame
+constexpr std::size_t can_fd_max_payload = 64;
+
+/**
+ * @brief View of a classic or CAN FD frame held by someone else
+ *
+ * Meant for drivers to pass the frames of their receive buffers to
+ * can_router::dispatch() without copying payloads. A view is only valid for
+ * as long as the driver keeps the buffer, which for a route handler means
+ * until the handler returns.
+ */
+struct can_frame
+{
+  hal::can::id_t id = 0;
+  /// Data of the frame, up to can_fd_max_payload bytes
+  std::span<const hal::byte> payload{};
+  bool is_remote_request = false;
+  /// Whether the frame uses the CAN FD format
+  bool is_fd = false;
+  /// Whether the data phase of a CAN FD frame used the faster bit rate
+  bool bit_rate_switch = false;
+
+  /**
+   * @brief View a classic message
+   *
+   * @param p_message - message to view. Must outlive the view.
+   * @return can_frame - view holding the first `length` bytes of the payload
+   */
+  [[nodiscard]] static constexpr can_frame view(
+    const can::message_t& p_message)
+  {
+    auto const length =
+      std::min<std::size_t>(p_message.length, p_message.payload.size());
+    return {
+      .id = p_message.id,
+      .payload = std::span(p_message.payload).first(length),
+      .is_remote_request = p_message.is_remote_request,
+    };
+  }
+
+  /**
+   * @return std::optional<can::message_t> - copy of the frame as a classic
+   * message, or std::nullopt if it is a CAN FD frame or its payload does not
+   * fit one.
+   */
+  [[nodiscard]] constexpr std::optional<can::message_t> classic() const
+  {
+    can::message_t message{
+      .id = id,
+      .length = static_cast<std::uint8_t>(payload.size()),
+      .is_remote_request = is_remote_request,
+    };
+    if (is_fd || payload.size() > message.payload.size()) {
+      return std::nullopt;
+    }
+    std::copy(payload.begin(), payload.end(), message.payload.begin());
+    return message;
+  }
+};
+
+/// Route handler taking a view of the frame rather than a copied message
+using can_frame_handler = hal::callback<void(const can_frame&)>;
+}  // namespace hal
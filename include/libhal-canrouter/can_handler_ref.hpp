@@ -0,0 +1,123 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <functional>
+#include <type_traits>
+
+#include <libhal/can.hpp>
+
+namespace hal {
+/**
+ * @brief Message handler held as a function pointer and a context pointer
+ *
+ * Two pointers wide regardless of what it calls, since it refers to the
+ * object it calls rather than holding a copy. That object must outlive every
+ * copy of the reference. It can refer to:
+ *
+ * - an object with a call operator, given as `std::ref(object)`
+ * - a lambda without captures, or another empty callable type
+ * - a free function taking the message
+ * - a function taking a context pointer and the message, with its context
+ *
+ * Lambdas with captures must become objects given with `std::ref()`.
+ */
+class can_handler_ref
+{
+public:
+  using thunk = void(void* p_context, const can::message_t& p_message);
+
+  /**
+   * @brief Construct a reference that ignores every message
+   *
+   */
+  constexpr can_handler_ref() = default;
+
+  /**
+   * @brief Construct a reference to a function and its context
+   *
+   * @param p_thunk - function to call with p_context and each message
+   * @param p_context - context passed to p_thunk. Must outlive the reference.
+   */
+  constexpr can_handler_ref(thunk* p_thunk, void* p_context)
+    : m_thunk(p_thunk)
+    , m_context(p_context)
+  {
+  }
+
+  /**
+   * @brief Construct a reference to an object with a call operator
+   *
+   * @param p_object - object to call with each message. Must outlive the
+   * reference.
+   */
+  template<class T>
+  constexpr can_handler_ref(std::reference_wrapper<T> p_object)
+    : m_thunk([](void* p_context, const can::message_t& p_message) {
+      (*static_cast<T*>(p_context))(p_message);
+    })
+    , m_context(const_cast<void*>(static_cast<const void*>(&p_object.get())))
+  {
+  }
+
+  /**
+   * @brief Construct a reference to an empty callable, such as a lambda
+   * without captures
+   *
+   * @param p_callable - callable to call with each message. Nothing is kept
+   * of it, since a default constructed one behaves the same.
+   */
+  template<class F>
+    requires(std::is_empty_v<F> && std::is_default_constructible_v<F> &&
+             std::is_invocable_v<const F&, const can::message_t&>)
+  constexpr can_handler_ref([[maybe_unused]] F p_callable)
+    : m_thunk([]([[maybe_unused]] void* p_context,
+                 const can::message_t& p_message) { F{}(p_message); })
+  {
+  }
+
+  /**
+   * @brief Construct a reference to a free function
+   *
+   * @param p_function - function to call with each message
+   */
+  can_handler_ref(void (*p_function)(const can::message_t&))
+    : m_thunk([](void* p_context, const can::message_t& p_message) {
+      reinterpret_cast<void (*)(const can::message_t&)>(p_context)(p_message);
+    })
+    , m_context(reinterpret_cast<void*>(p_function))
+  {
+  }
+
+  /**
+   * @brief Run the referenced handler
+   *
+   * @param p_message - message to pass to the handler
+   */
+  void operator()(const can::message_t& p_message) const
+  {
+    m_thunk(m_context, p_message);
+  }
+
+private:
+  static void ignore([[maybe_unused]] void* p_context,
+                     [[maybe_unused]] const can::message_t& p_message)
+  {
+  }
+
+  thunk* m_thunk = &ignore;
+  void* m_context = nullptr;
+};
+}  // namespace hal
@@ -0,0 +1,183 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include <libhal/can.hpp>
+#include <libhal/functional.hpp>
+#include <libhal/units.hpp>
+
+#include "can_placement.hpp"
+
+namespace hal {
+/**
+ * @brief Fixed pool of reassembly buffers shared by ISO-TP receivers
+ *
+ * The storage is split into equally sized buffers, each holding one message
+ * being reassembled. Receivers sharing a pool must run in the same context,
+ * such as the receive handler of one router.
+ */
+class can_isotp_pool
+{
+public:
+  /// Most buffers a pool can hand out
+  static constexpr std::size_t max_buffers = 32;
+
+  /**
+   * @brief Construct a new buffer pool
+   *
+   * @param p_storage - storage for the buffers. Must outlive the pool. Bytes
+   * beyond the last whole buffer, or beyond max_buffers buffers, are unused.
+   * @param p_buffer_size - size of each buffer, which is the longest message
+   * that can be reassembled. At most 4095 bytes are used.
+   * @throws hal::argument_out_of_domain - if p_storage cannot hold a single
+   * buffer of p_buffer_size bytes, or p_buffer_size is zero.
+   */
+  can_isotp_pool(std::span<hal::byte> p_storage, std::size_t p_buffer_size);
+
+  can_isotp_pool(can_isotp_pool& p_other) = delete;
+  can_isotp_pool& operator=(can_isotp_pool& p_other) = delete;
+
+  /**
+   * @brief Take a free buffer from the pool
+   *
+   * @return std::span<hal::byte> - the buffer, or an empty span if every
+   * buffer is in use.
+   */
+  [[nodiscard]] std::span<hal::byte> acquire();
+
+  /**
+   * @brief Return a buffer to the pool
+   *
+   * @param p_buffer - buffer returned by acquire(). Empty spans are ignored.
+   */
+  void release(std::span<hal::byte> p_buffer);
+
+  /**
+   * @return std::size_t - size of each buffer
+   */
+  [[nodiscard]] std::size_t buffer_size() const;
+
+  /**
+   * @return std::size_t - number of buffers not in use
+   */
+  [[nodiscard]] std::size_t available() const;
+
+private:
+  std::span<hal::byte> m_storage;
+  std::size_t m_buffer_size = 0;
+  std::size_t m_count = 0;
+  /// Bit n is set while buffer n is in use
+  std::uint32_t m_in_use = 0;
+};
+
+/**
+ * @brief Reassembles ISO-TP (ISO 15765-2) messages received on one ID
+ *
+ * Meant to be registered as a route, for example with
+ * `can_router::add_isotp()`, so that it runs in the receive handler. Single
+ * frames are delivered straight from the received frame. A first frame takes
+ * a buffer from the pool and is answered with a flow control frame at once,
+ * without waiting for the application, as is every completed block of
+ * consecutive frames. The complete message is then delivered as a span into
+ * the buffer, which returns to the pool when the handler returns.
+ *
+ * Uses normal addressing with classic CAN frames. Flow control frames are 8
+ * bytes long and padded with 0xCC. A sequence error, an exhausted pool or a
+ * message longer than the pool's buffers aborts the transfer, the latter two
+ * after answering with an overflow flow control frame.
+ */
+class can_isotp_receiver
+{
+public:
+  /// Called with each complete message. The span is only valid during the
+  /// call.
+  using payload_handler = void(std::span<const hal::byte> p_payload);
+
+  /**
+   * @brief Parameters of the flow control frames sent to the transmitter
+   *
+   */
+  struct flow_control
+  {
+    /// ID of the flow control frames
+    hal::can::id_t id = 0;
+    /// Consecutive frames the transmitter may send between flow control
+    /// frames, or zero to send them all without waiting
+    std::uint8_t block_size = 0;
+    /// Minimum separation time between consecutive frames, encoded as in the
+    /// STmin field of ISO 15765-2
+    std::uint8_t separation_time = 0;
+  };
+
+  /**
+   * @brief Construct a new ISO-TP receiver
+   *
+   * @param p_bus - bus to send flow control frames on. Must outlive the
+   * receiver.
+   * @param p_pool - pool to take reassembly buffers from. Must outlive the
+   * receiver.
+   * @param p_flow_control - parameters of the flow control frames
+   * @param p_handler - callback to be executed with each complete message
+   */
+  can_isotp_receiver(hal::can& p_bus,
+                     can_isotp_pool& p_pool,
+                     flow_control p_flow_control,
+                     hal::callback<payload_handler> p_handler);
+
+  can_isotp_receiver(can_isotp_receiver& p_other) = delete;
+  can_isotp_receiver& operator=(can_isotp_receiver& p_other) = delete;
+  ~can_isotp_receiver();
+
+  /**
+   * @brief Process a frame received for this receiver's ID
+   *
+   * @param p_message - frame received from the bus
+   */
+  void operator()(const can::message_t& p_message);
+
+  /**
+   * @return std::uint32_t - number of messages delivered. Wraps on overflow.
+   */
+  [[nodiscard]] std::uint32_t completed_count() const;
+
+  /**
+   * @return std::uint32_t - number of transfers aborted. Wraps on overflow.
+   */
+  [[nodiscard]] std::uint32_t aborted_count() const;
+
+private:
+  void receive_single(const can::message_t& p_message);
+  void receive_first(const can::message_t& p_message);
+  void receive_consecutive(const can::message_t& p_message);
+  bool send_flow_control(std::uint8_t p_status);
+  void abort();
+
+  hal::can* m_bus = nullptr;
+  can_isotp_pool* m_pool = nullptr;
+  flow_control m_flow_control{};
+  hal::callback<payload_handler> m_handler;
+  std::span<hal::byte> m_buffer{};
+  std::size_t m_expected = 0;
+  std::size_t m_received = 0;
+  std::uint8_t m_sequence = 0;
+  std::uint8_t m_block_remaining = 0;
+  std::uint32_t m_completed_count = 0;
+  std::uint32_t m_aborted_count = 0;
+};
+}  // namespace hal
@@ -0,0 +1,109 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+
+#include <libhal/can.hpp>
+#include <libhal/steady_clock.hpp>
+
+#include "can_placement.hpp"
+
+namespace hal {
+/**
+ * @brief Holds the latest message received for a route
+ *
+ * Meant for consumers that only need the freshest value of an ID, such as a
+ * control loop sampling a sensor. The receive handler (the writer) overwrites
+ * the message in place and readers take a consistent snapshot without locks
+ * using a sequence lock: a read that overlaps a write is retried.
+ *
+ * Exactly one context may write. Readers must not run in a context that can
+ * preempt the writer, such as a higher priority interrupt, since their retries
+ * would never observe the write completing.
+ */
+class can_mailbox
+{
+public:
+  /**
+   * @brief Copy of the latest message
+   *
+   */
+  struct snapshot
+  {
+    can::message_t message{};
+    /// Clock uptime when the message was written, or 0 without a clock
+    std::uint64_t timestamp = 0;
+    /// Number of messages written to the mailbox, including this one
+    std::uint32_t sequence = 0;
+  };
+
+  /**
+   * @brief Construct a mailbox that does not timestamp messages
+   *
+   */
+  can_mailbox() = default;
+
+  /**
+   * @brief Construct a mailbox that timestamps messages
+   *
+   * @param p_clock - clock read each time a message is written. Must outlive
+   * the mailbox.
+   */
+  explicit can_mailbox(hal::steady_clock& p_clock);
+
+  can_mailbox(can_mailbox& p_other) = delete;
+  can_mailbox& operator=(can_mailbox& p_other) = delete;
+
+  /**
+   * @brief Replace the mailbox contents with a message
+   *
+   * Must only be called from the writer context. Registering the mailbox as a
+   * route handler, for example with `can_router::add_mailbox()`, makes the
+   * receive handler the writer.
+   *
+   * @param p_message - message to store
+   */
+  void operator()(const can::message_t& p_message);
+
+  /**
+   * @brief Take a snapshot of the latest message
+   *
+   * @return std::optional<snapshot> - the latest message, or std::nullopt if
+   * no message has been written yet.
+   */
+  [[nodiscard]] std::optional<snapshot> read() const;
+
+  /**
+   * @brief Get the number of messages written to the mailbox
+   *
+   * Cheaper than read() for checking whether a new message has arrived since
+   * the last snapshot.
+   *
+   * @return std::uint32_t - number of messages written. Wraps on overflow.
+   */
+  [[nodiscard]] std::uint32_t sequence() const;
+
+private:
+  can::message_t m_message{};
+  std::uint64_t m_timestamp = 0;
+  hal::steady_clock* m_clock = nullptr;
+  // Incremented before and after every write, so it is odd while a write is
+  // in progress and twice the number of completed writes otherwise.
+  std::atomic<std::uint32_t> m_sequence = 0;
+};
+}  // namespace hal
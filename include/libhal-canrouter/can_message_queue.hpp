@@ -0,0 +1,103 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#include <libhal/can.hpp>
+
+#include "can_placement.hpp"
+
+namespace hal {
+/**
+ * @brief Lock free single producer, single consumer queue of CAN messages
+ *
+ * Meant to hand messages from a receive interrupt (the producer) to a main
+ * loop or task (the consumer) without disabling interrupts. Exactly one
+ * context may call push() and exactly one context may call pop().
+ *
+ * Every element of the storage is usable. When the queue is full, new
+ * messages are dropped and counted as overflows.
+ */
+class can_message_queue
+{
+public:
+  /**
+   * @brief Construct a new can message queue
+   *
+   * @param p_storage - storage for queued messages. Must outlive the queue.
+   * @throws hal::argument_out_of_domain - if p_storage is empty
+   */
+  explicit can_message_queue(std::span<can::message_t> p_storage);
+
+  can_message_queue(can_message_queue& p_other) = delete;
+  can_message_queue& operator=(can_message_queue& p_other) = delete;
+
+  /**
+   * @brief Add a message to the back of the queue
+   *
+   * Must only be called from the producer context.
+   *
+   * @param p_message - message to copy into the queue
+   * @return true - if the message was queued
+   * @return false - if the queue was full and the message was dropped
+   */
+  bool push(const can::message_t& p_message);
+
+  /**
+   * @brief Remove the message at the front of the queue
+   *
+   * Must only be called from the consumer context.
+   *
+   * @return std::optional<can::message_t> - the message, or std::nullopt if
+   * the queue is empty.
+   */
+  [[nodiscard]] std::optional<can::message_t> pop();
+
+  /**
+   * @return std::size_t - number of messages currently queued
+   */
+  [[nodiscard]] std::size_t size() const;
+
+  /**
+   * @return std::size_t - maximum number of messages that can be queued
+   */
+  [[nodiscard]] std::size_t capacity() const;
+
+  /**
+   * @return std::uint32_t - number of messages dropped because the queue was
+   * full
+   */
+  [[nodiscard]] std::uint32_t overflow_count() const;
+
+  /**
+   * @return std::size_t - largest number of messages that have been queued at
+   * once
+   */
+  [[nodiscard]] std::size_t high_water_mark() const;
+
+private:
+  std::span<can::message_t> m_storage;
+  // Positions run over twice the capacity, see ring_position
+  std::atomic<std::size_t> m_write = 0;
+  std::atomic<std::size_t> m_read = 0;
+  std::atomic<std::uint32_t> m_overflow_count = 0;
+  std::atomic<std::size_t> m_high_water_mark = 0;
+};
+}  // namespace hal
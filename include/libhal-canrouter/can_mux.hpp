@@ -0,0 +1,118 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include <libhal/can.hpp>
+#include <libhal/functional.hpp>
+
+#include "can_placement.hpp"
+
+namespace hal {
+/**
+ * @brief Second level dispatch of multiplexed messages on a payload selector
+ *
+ * Meant for devices that send many logical messages under one ID and tell
+ * them apart with a multiplexer field in the payload. Registering the mux as
+ * the route handler for that ID, for example with
+ * `router.add_message_callback(id, std::ref(mux))`, makes each message run
+ * the handler set for its selector value, found with one access to a table
+ * indexed by the value.
+ *
+ * Handlers are set and cleared from the context that configures the router.
+ * Changing one while messages with its ID are received is not supported.
+ */
+class can_mux
+{
+public:
+  using message_handler = hal::callback<hal::can::handler>;
+
+  /// Widest selector, which makes a 256 entry table
+  static constexpr std::uint8_t max_selector_width = 8;
+
+  /**
+   * @brief Location of the multiplexer field within the payload
+   *
+   * The selector value is `(payload[byte] >> shift) & ((1 << width) - 1)`.
+   */
+  struct selector
+  {
+    /// Payload byte holding the field
+    std::uint8_t byte = 0;
+    /// Position of the field's least significant bit within the byte
+    std::uint8_t shift = 0;
+    /// Number of bits in the field
+    std::uint8_t width = max_selector_width;
+  };
+
+  /**
+   * @brief Construct a new mux
+   *
+   * @param p_table - one handler per selector value, `1 << width` elements
+   * long. Must outlive the mux.
+   * @param p_selector - location of the multiplexer field
+   * @throws hal::argument_out_of_domain - if the field does not fit within a
+   * payload byte or p_table does not have `1 << width` elements.
+   */
+  can_mux(std::span<message_handler> p_table, selector p_selector);
+
+  can_mux(can_mux& p_other) = delete;
+  can_mux& operator=(can_mux& p_other) = delete;
+
+  /**
+   * @brief Set the handler for one selector value
+   *
+   * @param p_value - selector value
+   * @param p_handler - callback to be executed for messages with that value
+   * @throws hal::argument_out_of_domain - if p_value does not fit the field
+   */
+  void set(std::uint8_t p_value, message_handler p_handler);
+
+  /**
+   * @brief Remove the handler for one selector value
+   *
+   * @param p_value - selector value
+   * @throws hal::argument_out_of_domain - if p_value does not fit the field
+   */
+  void clear(std::uint8_t p_value);
+
+  /**
+   * @brief Run the handler for a message's selector value
+   *
+   * @param p_message - message received for the mux's ID
+   */
+  void operator()(const can::message_t& p_message);
+
+  /**
+   * @return std::uint32_t - number of messages that were too short to hold
+   * the field or whose value had no handler. Wraps on overflow.
+   */
+  [[nodiscard]] std::uint32_t unselected_count() const;
+
+private:
+  [[nodiscard]] bool is_set(std::size_t p_value) const;
+
+  std::span<message_handler> m_table;
+  selector m_selector{};
+  std::uint8_t m_mask = 0;
+  /// Bit n is set while selector value n has a handler
+  std::array<std::uint32_t, (1U << max_selector_width) / 32> m_set{};
+  std::uint32_t m_unselected_count = 0;
+};
+}  // namespace hal
@@ -0,0 +1,58 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+/**
+ * Section placement of the receive path
+ *
+ * Parts with tightly coupled or otherwise fast memory can run the receive
+ * path from it by defining these macros, for example on a Cortex-M7:
+ *
+ *     -DLIBHAL_CANROUTER_FAST_CODE='[[gnu::section(".itcm_text")]]'
+ *     -DLIBHAL_CANROUTER_FAST_DATA='[[gnu::section(".dtcm_data")]]'
+ *
+ * The sections must exist within the application's linker script, and code
+ * sections that are out of branch range of flash also need long calls. Like
+ * the other build flags, the macros must have the same value for the library
+ * and every file that includes it.
+ *
+ * LIBHAL_CANROUTER_FAST_CODE is applied to the library functions that run
+ * from the receive handler: the router's lookup and dispatch, pushing onto a
+ * can_message_queue, appending to a can_capture, admitting messages through a
+ * can_route_policy, and the library's own route handlers, which are
+ * can_forwarder, can_timeout, can_mailbox, can_isotp_receiver and can_mux.
+ * can_receiver is left out, since the coroutines it resumes are application
+ * code and its route is best deferred. The application's route handlers, and
+ * the driver calling the router, must be placed by the application.
+ *
+ * GCC ignores section attributes on templates, such as the receive handler
+ * of static_can_router or the standard algorithms used by the lookup. Those
+ * reach fast memory by being inlined into a placed function, or by placing
+ * their input sections from the linker script.
+ *
+ * The library owns no storage of its own. LIBHAL_CANROUTER_FAST_DATA is meant
+ * for the application's declarations of the router, its index, lookup tables,
+ * hot route cache and queue storage, which are what the receive path reads.
+ */
+
+#if !defined(LIBHAL_CANROUTER_FAST_CODE)
+/// Attribute placing the receive path's functions, empty by default
+#define LIBHAL_CANROUTER_FAST_CODE
+#endif
+
+#if !defined(LIBHAL_CANROUTER_FAST_DATA)
+/// Attribute placing the storage the receive path reads, empty by default
+#define LIBHAL_CANROUTER_FAST_DATA
+#endif
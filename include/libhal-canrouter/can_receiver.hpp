@@ -0,0 +1,180 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <coroutine>
+#include <cstdint>
+#include <optional>
+
+#include <libhal/can.hpp>
+
+#include "can_timeout.hpp"
+
+namespace hal {
+/**
+ * @brief Lets coroutines wait for the next message of a route
+ *
+ * Meant for request and response protocols written as coroutines. The
+ * receiver is registered once as a route handler, for example with
+ * `router.add_message_callback(id, std::ref(receiver))`, and any number of
+ * coroutines may then `co_await receiver.next()`. Each waiting coroutine is
+ * resumed with the next message the route receives, or with std::nullopt if
+ * the wait times out or is cancelled.
+ *
+ * Waits allocate nothing: each one is linked into the receiver from the
+ * awaiter held in the coroutine's frame, and unlinked again if that frame is
+ * destroyed while waiting. Each wait has its own deadline, so newer waits
+ * never delay the timeout of older ones.
+ *
+ * Coroutines are resumed from the context that runs the route, so the route
+ * is best left deferred and poll() called from the context that owns the
+ * coroutines. Timeouts resume coroutines from can_timeout_wheel::tick(),
+ * which must then be called from that same context.
+ */
+class can_receiver
+{
+  struct waiter_list;
+
+public:
+  /**
+   * @brief Awaitable result of next()
+   *
+   */
+  class awaiter
+  {
+  public:
+    awaiter(awaiter& p_other) = delete;
+    awaiter& operator=(awaiter& p_other) = delete;
+
+    /**
+     * @brief Stop waiting
+     *
+     * Only does anything when the coroutine's frame is destroyed while it
+     * waits, for example when its task is cancelled, so the receiver never
+     * resumes a destroyed coroutine.
+     */
+    ~awaiter();
+
+    [[nodiscard]] bool await_ready() const noexcept
+    {
+      return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> p_handle) noexcept;
+
+    [[nodiscard]] std::optional<can::message_t> await_resume() const noexcept
+    {
+      return m_message;
+    }
+
+  private:
+    friend class can_receiver;
+
+    explicit awaiter(can_receiver& p_receiver)
+      : m_receiver(&p_receiver)
+    {
+    }
+
+    can_receiver* m_receiver = nullptr;
+    std::coroutine_handle<> m_handle{};
+    waiter_list* m_list = nullptr;
+    awaiter* m_prev = nullptr;
+    awaiter* m_next = nullptr;
+    std::uint32_t m_started = 0;
+    std::optional<can::message_t> m_message{};
+  };
+
+  /**
+   * @brief Construct a receiver whose waits never time out
+   *
+   */
+  can_receiver() = default;
+
+  /**
+   * @brief Construct a receiver whose waits time out
+   *
+   * Each wait times out p_length ticks of the wheel after it begins, however
+   * many other waits are in flight. Must be constructed and destroyed from
+   * the context calling the wheel's tick(), which is also the context waits
+   * must begin from.
+   *
+   * @param p_wheel - wheel measuring the timeouts. Must outlive the receiver.
+   * @param p_length - ticks to wait for a message
+   * @throws hal::argument_out_of_domain - if p_length is zero.
+   */
+  can_receiver(can_timeout_wheel& p_wheel, std::uint32_t p_length);
+
+  can_receiver(can_receiver& p_other) = delete;
+  can_receiver& operator=(can_receiver& p_other) = delete;
+
+  /**
+   * @brief Resumes every waiting coroutine with std::nullopt
+   *
+   */
+  ~can_receiver();
+
+  /**
+   * @brief Wait for the next message
+   *
+   * @return awaiter - awaitable producing the message, or std::nullopt if the
+   * wait timed out or was cancelled.
+   */
+  [[nodiscard]] awaiter next();
+
+  /**
+   * @brief Resume every waiting coroutine with a message
+   *
+   * Called by the router for each message matching the receiver's route.
+   * Coroutines are resumed in the order they began waiting. Coroutines that
+   * wait again while being resumed wait for the following message.
+   *
+   * @param p_message - message received for the route
+   */
+  void operator()(const can::message_t& p_message);
+
+  /**
+   * @brief Resume every waiting coroutine with std::nullopt
+   *
+   */
+  void cancel();
+
+  /**
+   * @return true - if at least one coroutine is waiting
+   */
+  [[nodiscard]] bool waiting() const;
+
+private:
+  /// Waits in the order they began, linked through their awaiters
+  struct waiter_list
+  {
+    void push_back(awaiter& p_waiter);
+    void erase(awaiter& p_waiter);
+    awaiter* pop_front();
+
+    awaiter* m_head = nullptr;
+    awaiter* m_tail = nullptr;
+  };
+
+  void expire();
+  void resume_all(const std::optional<can::message_t>& p_message);
+  static void resume(waiter_list& p_waiters,
+                     const std::optional<can::message_t>& p_message);
+
+  waiter_list m_waiters{};
+  can_timeout_wheel* m_wheel = nullptr;
+  std::uint32_t m_length = 0;
+  std::optional<can_timeout> m_timeout{};
+};
+}  // namespace hal
@@ -0,0 +1,126 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include <libhal/steady_clock.hpp>
+#include <libhal/units.hpp>
+
+#include "can_capture.hpp"
+#include "can_router.hpp"
+
+namespace hal {
+/**
+ * @brief Parse one line of a candump log
+ *
+ * Accepts the log format written by `candump -L` and read by `canplayer`, for
+ * example `(1436509052.249713) can0 123#DEADBEEF`. Data bytes may be separated
+ * by dots, remote requests are written as `123#R` with an optional length
+ * digit, and the number at the end of the interface name becomes the bus.
+ * Timestamps are converted to microseconds and truncated to 32 bits.
+ *
+ * @param p_line - line to parse, with or without its line ending
+ * @return std::optional<can_capture::record> - the message, or std::nullopt
+ * if the line is not a classic CAN frame in the log format.
+ */
+[[nodiscard]] std::optional<can_capture::record> parse_candump(
+  std::string_view p_line);
+
+/**
+ * @brief Feeds recorded traffic back into a router
+ *
+ * Meant for reproducing field traffic on a host or on the bench, for load
+ * testing and for profiling dispatch. Records are delivered with
+ * can_router::dispatch() on the bus they were captured from, either as fast
+ * as possible or paced by a clock to their original spacing, optionally
+ * scaled. Records from a bus the router does not have are skipped.
+ *
+ * Pacing busy waits on the clock, so it is only as precise as the clock and
+ * the time taken by the routes allow.
+ */
+class can_replay
+{
+public:
+  /// Frequency of the timestamps produced by parse_candump()
+  static constexpr hal::hertz candump_frequency = 1'000'000.0f;
+
+  /**
+   * @brief Construct a replay that delivers records as fast as possible
+   *
+   * @param p_router - router to deliver records to. Must outlive the replay.
+   */
+  explicit can_replay(can_router& p_router);
+
+  /**
+   * @brief Construct a replay paced to the records' own timing
+   *
+   * @param p_router - router to deliver records to. Must outlive the replay.
+   * @param p_clock - clock to pace the replay with. Must outlive the replay.
+   * @param p_speed - how many times faster than recorded to replay, 1.0 for
+   * the original speed
+   * @throws hal::argument_out_of_domain - if p_speed is not positive.
+   */
+  can_replay(can_router& p_router,
+             hal::steady_clock& p_clock,
+             float p_speed = 1.0f);
+
+  /**
+   * @brief Replay a capture
+   *
+   * @param p_records - records to replay, oldest first
+   * @param p_frequency - frequency of the records' timestamps, such as
+   * can_capture::frequency() of the capture that recorded them
+   * @return std::size_t - number of records delivered
+   */
+  std::size_t play(std::span<const can_capture::record> p_records,
+                   hal::hertz p_frequency);
+
+  /**
+   * @brief Replay a candump log
+   *
+   * Lines that parse_candump() rejects are skipped.
+   *
+   * @param p_log - contents of the log, one frame per line
+   * @return std::size_t - number of frames delivered
+   */
+  std::size_t play(std::string_view p_log);
+
+  /**
+   * @return std::uint32_t - number of records skipped because their bus was
+   * not part of the router
+   */
+  [[nodiscard]] std::uint32_t skipped_count() const;
+
+private:
+  void restart(hal::hertz p_frequency);
+  bool deliver(const can_capture::record& p_record);
+
+  can_router* m_router;
+  hal::steady_clock* m_clock = nullptr;
+  float m_speed = 1.0f;
+  /// Clock ticks per record tick, 0 when not pacing
+  double m_ticks_per_record_tick = 0.0;
+  std::uint64_t m_start = 0;
+  std::uint64_t m_elapsed = 0;
+  std::uint32_t m_previous = 0;
+  bool m_started = false;
+  std::uint32_t m_skipped_count = 0;
+};
+}  // namespace hal
@@ -0,0 +1,171 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include <libhal/can.hpp>
+#include <libhal/steady_clock.hpp>
+#include <libhal/units.hpp>
+
+#include "can_frame.hpp"
+#include "can_placement.hpp"
+
+namespace hal {
+/**
+ * @brief Limits on how often a route's handler runs
+ *
+ * Meant to bound the time spent on any single ID when a node floods the bus.
+ * A route with a policy, set through `can_router::route::policy`, only runs
+ * its handler for messages the policy admits. The route stays registered and
+ * every suppressed message is counted.
+ *
+ * Policies are checked in this order: decimation counts every message the
+ * route receives, change detection compares the messages that decimation
+ * passes, and the rate limit counts the messages that would otherwise run the
+ * handler. A policy holds the state of one route and must not be shared.
+ */
+class can_route_policy
+{
+public:
+  /**
+   * @brief Number of messages a policy has suppressed, by reason
+   *
+   */
+  struct suppressed_counts
+  {
+    /// Skipped by decimation
+    std::uint32_t decimated = 0;
+    /// Skipped for repeating the previous payload
+    std::uint32_t unchanged = 0;
+    /// Skipped for exceeding the rate limit
+    std::uint32_t rate_limited = 0;
+  };
+
+  /**
+   * @brief Construct a policy that admits every message
+   *
+   */
+  can_route_policy() = default;
+
+  can_route_policy(can_route_policy& p_other) = delete;
+  can_route_policy& operator=(can_route_policy& p_other) = delete;
+
+  /**
+   * @brief Limit the number of handler runs within a time window
+   *
+   * Windows are consecutive: one starts with the first admitted message after
+   * the previous window has ended.
+   *
+   * @param p_clock - clock to measure windows with, or nullptr to remove the
+   * limit. Must outlive the policy or be replaced before it is destroyed.
+   * @param p_window - length of each window
+   * @param p_max_runs - most handler runs within one window
+   */
+  void limit_rate(hal::steady_clock* p_clock,
+                  hal::time_duration p_window,
+                  std::uint32_t p_max_runs);
+
+  /**
+   * @brief Only admit every Nth message
+   *
+   * @param p_every - admit one message out of every p_every, starting with the
+   * first. Zero or one admits every message.
+   */
+  void decimate(std::uint32_t p_every);
+
+  /**
+   * @brief Only admit messages whose contents differ from the previous one
+   *
+   * Compares the length, remote request flag and payload against the last
+   * admitted message. Only the first `length` bytes of the payload are
+   * compared, as one 64-bit word. The first message is always admitted, and
+   * so is every CAN FD frame with more than 8 bytes of payload.
+   *
+   * @param p_enabled - whether repeated messages are suppressed
+   * @param p_refresh_every - admit a repeated message anyway when it is the
+   * p_refresh_every-th message since the last admitted one, so the handler
+   * runs at least that often for periodic messages. Zero never refreshes.
+   */
+  void only_on_change(bool p_enabled, std::uint32_t p_refresh_every = 0);
+
+  /**
+   * @brief Decide whether a message may run the route's handler
+   *
+   * Called by the router before every handler run. Must only be called from
+   * one context at a time.
+   *
+   * @param p_message - message received for the route
+   * @return true - if the handler should run for this message
+   */
+  [[nodiscard]] bool admit(const can::message_t& p_message);
+
+  /**
+   * @brief Decide whether a frame may run the route's handler
+   *
+   * Called by the router before every handler run for frames dispatched as
+   * a can_frame, including CAN FD frames. Must only be called from one
+   * context at a time.
+   *
+   * @param p_frame - frame received for the route
+   * @return true - if the handler should run for this frame
+   */
+  [[nodiscard]] bool admit(const can_frame& p_frame);
+
+  /**
+   * @return suppressed_counts - number of messages suppressed by each policy.
+   * Wraps on overflow.
+   */
+  [[nodiscard]] suppressed_counts suppressed() const;
+
+  /**
+   * @brief Clear the suppressed message counts
+   *
+   */
+  void reset_suppressed();
+
+private:
+  [[nodiscard]] static std::uint64_t payload_word(
+    const can::message_t& p_message);
+  [[nodiscard]] static std::uint64_t payload_word(
+    std::span<const hal::byte> p_payload);
+  [[nodiscard]] bool admit(std::size_t p_length,
+                           bool p_remote_request,
+                           std::uint64_t p_payload,
+                           bool p_comparable);
+  [[nodiscard]] bool repeats_last(std::size_t p_length,
+                                  bool p_remote_request,
+                                  std::uint64_t p_payload) const;
+
+  hal::steady_clock* m_clock = nullptr;
+  std::uint64_t m_window = 0;
+  std::uint64_t m_window_start = 0;
+  std::uint32_t m_max_runs = 0;
+  std::uint32_t m_window_runs = 0;
+  std::uint32_t m_every = 0;
+  std::uint32_t m_decimation_count = 0;
+  std::uint32_t m_refresh_every = 0;
+  std::uint32_t m_unchanged_run = 0;
+  /// Payload of the last admitted message, with bytes past its length zeroed
+  std::uint64_t m_last_payload = 0;
+  std::uint8_t m_last_length = 0;
+  bool m_last_remote_request = false;
+  bool m_has_last = false;
+  bool m_only_on_change = false;
+  suppressed_counts m_suppressed{};
+};
+}  // namespace hal
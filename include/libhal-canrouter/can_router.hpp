@@ -14,29 +14,393 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+
 #include <libhal-util/static_list.hpp>
 #include <libhal/can.hpp>
+#include <libhal/functional.hpp>
+
+#include "can_capture.hpp"
+#include "can_forwarder.hpp"
+#include "can_frame.hpp"
+#include "can_handler_ref.hpp"
+#include "can_isotp.hpp"
+#include "can_mailbox.hpp"
+#include "can_message_queue.hpp"
+#include "can_placement.hpp"
+#include "can_route_policy.hpp"
+#include "can_timeout.hpp"
+
+#if !defined(LIBHAL_CANROUTER_INSTRUMENTATION)
+/// Set to 1 to record dispatch statistics within every can_router and route.
+/// Must have the same value for the library and every file that includes it:
+/// the CMake target and the conan `instrumentation` option pass it on, and
+/// files built with another value fail to link against the library.
+#define LIBHAL_CANROUTER_INSTRUMENTATION 0
+#endif
+
+#if LIBHAL_CANROUTER_INSTRUMENTATION
+#include <libhal/steady_clock.hpp>
+/// Tags the symbols of the instrumented router, so that linking files built
+/// with and without instrumentation fails rather than mixing layouts
+#define LIBHAL_CANROUTER_ABI_TAG [[gnu::abi_tag("instrumented")]]
+#else
+#define LIBHAL_CANROUTER_ABI_TAG
+#endif
 
 namespace hal {
 /**
  * @brief Route CAN messages received on the can bus to callbacks based on ID.
  *
+ * Every route matching a message's ID receives the message, so several
+ * modules may subscribe to the same ID independently.
+ *
+ * By default, routes are searched linearly in the order they were registered.
+ * If the router is constructed with index storage, routes are also kept in a
+ * contiguous array sorted by ID and messages are located with a binary search,
+ * making the worst case lookup time O(log n) rather than O(n). An indexed
+ * router may additionally be given a direct lookup table for standard (11-bit)
+ * IDs, reducing their lookup to a single array access while extended IDs
+ * continue to use the binary search. Indexed routers can also cache the
+ * lookups of the most frequently received IDs, and can double buffer their
+ * index so that routes may change while messages are being received.
+ *
+ * Dispatch can also be deferred: the receive handler then only copies each
+ * routed message into a lock free queue and handlers run when the application
+ * calls poll() from its main loop or task. Latency critical routes can opt out
+ * of this and keep running in the receive handler. Deferred routes can be
+ * spread over several execution contexts, such as the cores of a multicore
+ * part, each polling lock free queues of its own.
+ *
+ * A router may receive from several buses at once. Every bus shares the same
+ * routes and index, each route either receives from every bus or from one of
+ * them, and handlers can ask which bus the message they were given came from.
+ *
+ * Routes may be given a can_route_policy to decimate, deduplicate or rate
+ * limit the messages that run their handler, bounding the time a flood of one
+ * ID can take from the rest of the application. The policy of a deferred
+ * route is applied in the receive handler, so suppressed messages are never
+ * queued and a flood cannot fill the queue shared with other routes.
+ *
+ * When built with `LIBHAL_CANROUTER_INSTRUMENTATION` set to 1, the router
+ * counts received and unrouted messages, and every route records how often
+ * and how long its handler runs. Otherwise none of this exists and dispatch is
+ * unchanged.
+ *
+ * Each route holds its handler as a hal::callback. Routes added with
+ * add_thin_route() hold a can_handler_ref instead, two pointers that refer to
+ * the handler rather than holding it, which shrinks the route and keeps more
+ * of them in cache during lookup. Their handlers must be objects given with
+ * `std::ref()`, free functions or lambdas without captures. Both kinds of
+ * route share the router, its index and every other feature.
+ *
+ * Drivers for CAN FD, or that would rather not copy frames, can dispatch views
+ * of their receive buffers as can_frame. Routes choose between a handler
+ * given a copied classic message and a `frame_handler` given the view, and
+ * both kinds share one index.
+ *
+ * The receive path can be placed in fast memory, such as ITCM, through the
+ * macros described in can_placement.hpp.
+ *
  */
-class can_router
+class LIBHAL_CANROUTER_ABI_TAG can_router
 {
 public:
   static constexpr auto noop =
     []([[maybe_unused]] const can::message_t& p_message) {};
 
   using message_handler = hal::callback<hal::can::handler>;
+  /// Handler held by a thin_route
+  using thin_message_handler = can_handler_ref;
+
+  /// Maximum number of buses a router can receive from
+  static constexpr std::size_t max_buses = 4;
+
+  /// Bus of a route that receives messages from every bus
+  static constexpr std::uint8_t any_bus = 0xFF;
+
+  /// Maximum number of execution contexts deferred routes can be spread over
+  static constexpr std::size_t max_contexts = 4;
+
+  /// Number of distinct standard (11-bit) CAN IDs
+  static constexpr std::size_t standard_id_count = 0x800;
+
+  /**
+   * @brief Direct lookup table for standard (11-bit) IDs
+   *
+   * Each element holds one more than the position, within the index, of the
+   * first route for that ID, or zero if the ID has no route. Applications only
+   * need this type to allocate the table. Its contents are managed by the
+   * can_router.
+   */
+  using standard_id_table = std::array<std::uint16_t, standard_id_count>;
+
+  /// Number of bits in the Bloom filter for extended IDs of an id_filter
+  static constexpr std::size_t extended_filter_bits = 1024;
+
+  /**
+   * @brief Membership filter for the IDs of every route
+   *
+   * Standard IDs are held in an exact bitmap. Extended IDs are held in a Bloom
+   * filter, which may pass an ID that has no route but never rejects one that
+   * does. Applications only need this type to allocate the filter. Its
+   * contents are managed by the can_router.
+   */
+  struct id_filter
+  {
+    std::array<std::uint32_t, standard_id_count / 32> standard{};
+    std::array<std::uint32_t, extended_filter_bits / 32> extended{};
+    /// Set when a mask or range route may match any extended ID
+    bool every_extended = false;
+  };
+
+  /// Mask comparing every bit of a message ID
+  static constexpr hal::can::id_t exact_mask = 0xFFFF'FFFF;
+
+  /// Mask covering every bit of a 29-bit extended CAN ID
+  static constexpr hal::can::id_t extended_id_mask = 0x1FFF'FFFF;
+
+  /**
+   * @brief Route matching every ID where `(id & mask) == value`
+   *
+   */
+  struct id_mask
+  {
+    hal::can::id_t value = 0;
+    hal::can::id_t mask = exact_mask;
+  };
+
+  /**
+   * @brief Route matching every ID from `first` to `last` inclusive
+   *
+   */
+  struct id_range
+  {
+    hal::can::id_t first = 0;
+    hal::can::id_t last = 0;
+  };
+
+  /**
+   * @brief Hardware acceptance filter
+   *
+   * Accepts every message where `(message.id & mask) == id`. Masks only cover
+   * the 29 bits of an extended ID.
+   */
+  struct acceptance_filter
+  {
+    hal::can::id_t id = 0;
+    hal::can::id_t mask = extended_id_mask;
+  };
+
+  /**
+   * @brief Where a route's handler runs while dispatch is deferred
+   *
+   */
+  enum class dispatch_mode : std::uint8_t
+  {
+    /// Run from poll()
+    deferred,
+    /// Run from the receive handler, ahead of any queued messages
+    immediate,
+  };
+
+#if LIBHAL_CANROUTER_INSTRUMENTATION
+  /**
+   * @brief Dispatch statistics of a single route
+   *
+   * Times are in ticks of the clock passed to instrument() and are only
+   * recorded while a clock is set.
+   */
+  struct route_statistics
+  {
+    /// Number of times the handler has run
+    std::uint32_t hits = 0;
+    /// Clock uptime when the handler last started running
+    std::uint64_t last_received = 0;
+    /// Shortest handler run time, or the maximum value if never timed
+    std::uint64_t min_duration = std::numeric_limits<std::uint64_t>::max();
+    /// Longest handler run time
+    std::uint64_t max_duration = 0;
+    /// Sum of every timed handler run
+    std::uint64_t total_duration = 0;
+  };
+
+  /**
+   * @brief Dispatch statistics of a router
+   *
+   */
+  struct router_statistics
+  {
+    /// Number of messages received from the bus
+    std::uint32_t received = 0;
+    /// Number of received messages that matched no route, as reported by
+    /// unrouted_count()
+    std::uint32_t misses = 0;
+  };
+#endif
+
+  /**
+   * @brief A route for messages to a handler
+   *
+   * A message matches when `(message.id & mask) - id <= range`, which covers
+   * exact IDs (the defaults), masked IDs and ranges of IDs with one compare.
+   *
+   * @tparam Handler - message_handler for a route, thin_message_handler for a
+   * thin_route
+   */
+  template<class Handler>
+  struct basic_route
+  {
+    hal::can::id_t id = 0;
+    Handler handler = noop;
+    /// Bits of the message ID that are compared against `id`
+    hal::can::id_t mask = exact_mask;
+    /// Number of consecutive IDs after `id` that also match
+    hal::can::id_t range = 0;
+    /// Context the handler runs in when the router defers dispatch
+    dispatch_mode dispatch = dispatch_mode::deferred;
+    /// Bus the route receives from, numbered as by attach(), or any_bus
+    std::uint8_t bus = any_bus;
+    /// Execution context whose poll_context() runs the handler when dispatch
+    /// is deferred, less than max_contexts
+    std::uint8_t context = 0;
+    /// Limits on how often the handler runs, or nullptr to run it for every
+    /// message. Applied before deferred messages are queued, so the handler
+    /// still runs for a message it suppressed that another deferred route of
+    /// the same context queued. Must outlive the route.
+    can_route_policy* policy = nullptr;
+    /// Handler given a view of each frame in place of `handler`, or nullptr
+    /// to run `handler`. The only handler run for CAN FD frames and frames
+    /// longer than 8 bytes. Must outlive the route.
+    can_frame_handler* frame_handler = nullptr;
+#if LIBHAL_CANROUTER_INSTRUMENTATION
+    /// Recorded by the router each time the handler runs
+    route_statistics statistics{};
+#endif
 
-  struct route
+    /**
+     * @param p_id - ID of a received message
+     * @return true - if the message should be delivered to this route
+     */
+    [[nodiscard]] constexpr bool matches(hal::can::id_t p_id) const
+    {
+      return static_cast<hal::can::id_t>((p_id & mask) - id) <= range;
+    }
+
+    /**
+     * @return true - if this route matches exactly one ID
+     */
+    [[nodiscard]] constexpr bool exact() const
+    {
+      return mask == exact_mask && range == 0;
+    }
+
+    /**
+     * @param p_bus - bus a message was received on
+     * @return true - if this route receives messages from that bus
+     */
+    [[nodiscard]] constexpr bool receives_from(std::uint8_t p_bus) const
+    {
+      return bus == any_bus || bus == p_bus;
+    }
+  };
+
+  /// Route holding its handler as a hal::callback
+  using route = basic_route<message_handler>;
+  /// Route referring to its handler through a can_handler_ref
+  using thin_route = basic_route<thin_message_handler>;
+
+  /**
+   * @brief Entry within the sorted route index
+   *
+   * Applications only need this type to allocate storage for the index. The
+   * contents are managed by the can_router. Routes for exact IDs fill the
+   * storage from the front in ID order, while mask and range routes fill it
+   * from the back in registration order.
+   */
+  struct index_entry
   {
     hal::can::id_t id = 0;
-    message_handler handler = noop;
+    /// Whether `target` is a thin_route and `owner` a thin_route_item
+    bool thin = false;
+    void* target = nullptr;
+    void* owner = nullptr;
   };
 
-  using route_item = static_list<route>::item;
+  /**
+   * @brief Routes matching one ID within an indexed router
+   *
+   */
+  struct route_group
+  {
+    /// Index entries of the routes for exactly this ID
+    std::span<const index_entry> exact{};
+    /// Whether routes beyond `exact` must be searched: the mask and range
+    /// routes of an indexed router, or every route of a linear router
+    bool wildcards = true;
+  };
+
+  /**
+   * @brief Line of the hot route cache
+   *
+   * Applications only need this type to allocate storage for the cache. The
+   * contents are managed by the can_router.
+   */
+  struct hot_route
+  {
+    hal::can::id_t id = 0;
+    route_group group{};
+    /// Version of the index the line was filled from, zero if unused
+    std::uint32_t generation = 0;
+  };
+
+  /**
+   * @brief Handle to a registered route
+   *
+   * The route remains registered for as long as this object lives. Destroying
+   * it removes the route from the router's list and, if present, its index.
+   * The ID of a route is captured at registration time and must not be changed
+   * through `get()` afterwards. Neither should its bus while messages are
+   * being received.
+   *
+   * @tparam Route - route or thin_route
+   */
+  template<class Route>
+  class basic_route_item
+  {
+  public:
+    basic_route_item(basic_route_item& p_other) = delete;
+    basic_route_item& operator=(basic_route_item& p_other) = delete;
+    basic_route_item(basic_route_item&& p_other) noexcept;
+    basic_route_item& operator=(basic_route_item&& p_other) noexcept;
+    ~basic_route_item();
+
+    /**
+     * @brief Access the route held by this item
+     *
+     * @return Route& - the registered route
+     */
+    [[nodiscard]] Route& get();
+
+  private:
+    friend class can_router;
+
+    basic_route_item(can_router* p_router,
+                     typename static_list<Route>::item&& p_item);
+
+    typename static_list<Route>::item m_item;
+    can_router* m_router = nullptr;
+  };
+
+  /// Handle to a registered route
+  using route_item = basic_route_item<route>;
+  /// Handle to a registered thin_route
+  using thin_route_item = basic_route_item<thin_route>;
 
   /**
    * @brief Construct a new can message router
@@ -45,6 +409,37 @@ public:
    */
   explicit can_router(hal::can& p_can);
 
+  /**
+   * @brief Construct a new can message router with an indexed lookup
+   *
+   * Every route added to this router is inserted into `p_index_storage`,
+   * sorted by ID. The storage must outlive the router and its size determines
+   * the maximum number of routes that can be registered.
+   *
+   * @param p_can - can peripheral to route messages for
+   * @param p_index_storage - storage for the sorted route index
+   */
+  can_router(hal::can& p_can, std::span<index_entry> p_index_storage);
+
+  /**
+   * @brief Construct a new can message router with an indexed lookup and a
+   * direct lookup table for standard IDs
+   *
+   * Messages with standard IDs are located with a single access to
+   * `p_standard_table`. Extended IDs are located with a binary search over the
+   * extended portion of the index. The table costs 4kB of RAM and must outlive
+   * the router.
+   *
+   * @param p_can - can peripheral to route messages for
+   * @param p_index_storage - storage for the sorted route index
+   * @param p_standard_table - direct lookup table for standard IDs
+   * @throws hal::argument_out_of_domain - if p_index_storage has more entries
+   * than p_standard_table can refer to.
+   */
+  can_router(hal::can& p_can,
+             std::span<index_entry> p_index_storage,
+             standard_id_table& p_standard_table);
+
   can_router() = delete;
   can_router(can_router& p_other) = delete;
   can_router& operator=(can_router& p_other) = delete;
@@ -62,29 +457,268 @@ public:
    */
   [[nodiscard]] hal::can& bus();
 
+  /**
+   * @brief Get a reference to one of the buses the router receives from
+   *
+   * @param p_bus - bus number, as returned by attach(). The bus passed to the
+   * constructor is bus 0.
+   * @return can& reference to the can peripheral driver
+   * @throws hal::argument_out_of_domain - if no bus has that number
+   */
+  [[nodiscard]] hal::can& bus(std::uint8_t p_bus);
+
+  /**
+   * @return std::uint8_t - number of buses the router receives from
+   */
+  [[nodiscard]] std::uint8_t bus_count() const;
+
+  /**
+   * @brief Receive messages from another bus
+   *
+   * Messages from every bus are resolved through the same routes and index.
+   * Routes with `bus` set to the returned number only receive messages from
+   * this bus, while routes with `any_bus` receive them from all of them.
+   *
+   * The receive handlers of every bus share the router's lookup state, so
+   * they must not preempt one another: give the buses' receive interrupts the
+   * same priority, or call dispatch() for each bus from one context.
+   *
+   * @param p_can - can peripheral to also route messages for. Must outlive the
+   * router.
+   * @return std::uint8_t - number of the bus within this router
+   * @throws hal::resource_unavailable_try_again - if the router already
+   * receives from max_buses buses.
+   */
+  std::uint8_t attach(hal::can& p_can);
+
+  /**
+   * @brief Get the bus that the message being handled was received on
+   *
+   * Only meaningful while a route handler is running, whether from the
+   * receive handler or from poll().
+   *
+   * @return std::uint8_t - number of the bus, as returned by attach()
+   */
+  [[nodiscard]] std::uint8_t source_bus() const;
+
+  /**
+   * @brief Get the bus of the message being handled by one execution context
+   *
+   * Meant for the handlers of contexts other than 0, which poll_context()
+   * runs alongside the receive handler and so cannot share source_bus(). Only
+   * meaningful while a route handler of that context is running from
+   * poll_context().
+   *
+   * @param p_context - execution context running the handler
+   * @return std::uint8_t - number of the bus, as returned by attach()
+   */
+  [[nodiscard]] std::uint8_t source_bus(std::uint8_t p_context) const;
+
+  /**
+   * @brief Add a fully specified route
+   *
+   * Meant for routes that need fields the add_message_callback() overloads do
+   * not take, such as a route receiving from a single bus:
+   *
+   *     router.add_route({ .id = 0x100, .handler = handler, .bus = 1 });
+   *
+   * @param p_route - route to register
+   * @return route_item - route item from the linked list that must be stored
+   * in a variable
+   * @throws hal::argument_out_of_domain - if the route's bus is neither
+   * any_bus nor less than max_buses.
+   * @throws hal::resource_unavailable_try_again - if the router is indexed and
+   * the index storage is full.
+   */
+  [[nodiscard]] route_item add_route(route p_route);
+
+  /**
+   * @brief Add a fully specified route that refers to its handler
+   *
+   * Meant for footprint sensitive applications with many routes. The route is
+   * dispatched exactly like one given to add_route(), but holds its handler
+   * as a can_handler_ref rather than a hal::callback:
+   *
+   *     router.add_thin_route({ .id = 0x100, .handler = std::ref(handler) });
+   *
+   * A router without an index runs the routes of add_route() matching a
+   * message before its thin routes.
+   *
+   * @param p_route - route to register
+   * @return thin_route_item - route item from the linked list that must be
+   * stored in a variable
+   * @throws hal::argument_out_of_domain - if the route's bus is neither
+   * any_bus nor less than max_buses.
+   * @throws hal::resource_unavailable_try_again - if the router is indexed and
+   * the index storage is full.
+   */
+  [[nodiscard]] thin_route_item add_thin_route(thin_route p_route);
+
   /**
    * @brief Add a message route without setting the callback
    *
    * The default callback will do nothing and will drop the message.
    *
    * @param p_id - Associated ID of messages to be stored.
-   * @return auto - route item from the linked list that must be stored stored
+   * @return route_item - route item from the linked list that must be stored
    * in a variable
+   * @throws hal::resource_unavailable_try_again - if the router is indexed and
+   * the index storage is full.
    */
-  [[nodiscard]] static_list<route>::item add_message_callback(
-    hal::can::id_t p_id);
+  [[nodiscard]] route_item add_message_callback(hal::can::id_t p_id);
 
   /**
    * @brief Set a callback for when messages with a specific ID is received
    *
    * @param p_id - Associated ID of messages to be stored.
    * @param p_handler - callback to be executed when a p_id message is received.
-   * @return auto - route item from the linked list that must be stored stored
+   * @param p_dispatch - context the handler runs in while dispatch is deferred
+   * @return route_item - route item from the linked list that must be stored
    * in a variable
+   * @throws hal::resource_unavailable_try_again - if the router is indexed and
+   * the index storage is full.
    */
-  [[nodiscard]] static_list<route>::item add_message_callback(
+  [[nodiscard]] route_item add_message_callback(
     hal::can::id_t p_id,
-    message_handler p_handler);
+    message_handler p_handler,
+    dispatch_mode p_dispatch = dispatch_mode::deferred);
+
+  /**
+   * @brief Set a callback for messages whose masked ID matches a value
+   *
+   * In an indexed router, mask routes are only searched after the exact ID
+   * routes and are searched linearly.
+   *
+   * @param p_match - value and mask that the message ID must match
+   * @param p_handler - callback to be executed when a matching message is
+   * received.
+   * @param p_dispatch - context the handler runs in while dispatch is deferred
+   * @return route_item - route item from the linked list that must be stored
+   * in a variable
+   * @throws hal::resource_unavailable_try_again - if the router is indexed and
+   * the index storage is full.
+   */
+  [[nodiscard]] route_item add_message_callback(
+    id_mask p_match,
+    message_handler p_handler,
+    dispatch_mode p_dispatch = dispatch_mode::deferred);
+
+  /**
+   * @brief Set a callback for messages with an ID within a range
+   *
+   * In an indexed router, range routes are only searched after the exact ID
+   * routes and are searched linearly.
+   *
+   * @param p_match - first and last ID of the range
+   * @param p_handler - callback to be executed when a matching message is
+   * received.
+   * @param p_dispatch - context the handler runs in while dispatch is deferred
+   * @return route_item - route item from the linked list that must be stored
+   * in a variable
+   * @throws hal::argument_out_of_domain - if the range's last ID is less than
+   * its first ID.
+   * @throws hal::resource_unavailable_try_again - if the router is indexed and
+   * the index storage is full.
+   */
+  [[nodiscard]] route_item add_message_callback(
+    id_range p_match,
+    message_handler p_handler,
+    dispatch_mode p_dispatch = dispatch_mode::deferred);
+
+  /**
+   * @brief Store the latest message with an ID in a mailbox
+   *
+   * The route always runs from the receive handler, even while dispatch is
+   * deferred, so the mailbox is written as soon as the message arrives and
+   * readers take snapshots from any lower priority context.
+   *
+   * @param p_id - Associated ID of messages to be stored
+   * @param p_mailbox - mailbox to write. Must outlive the route.
+   * @return route_item - route item from the linked list that must be stored
+   * in a variable
+   * @throws hal::resource_unavailable_try_again - if the router is indexed and
+   * the index storage is full.
+   */
+  [[nodiscard]] route_item add_mailbox(hal::can::id_t p_id,
+                                       can_mailbox& p_mailbox);
+
+  /**
+   * @brief Forward messages with a specific ID to another bus
+   *
+   * The route always runs from the receive handler, even while dispatch is
+   * deferred. Forwarding many IDs costs one route each, found by the same
+   * lookup as every other route, rather than one user callback each.
+   *
+   * @param p_id - Associated ID of messages to be forwarded
+   * @param p_forwarder - forwarder sending to the destination bus. Must
+   * outlive the route.
+   * @param p_source_bus - bus to forward messages from, or any_bus. A
+   * forwarder sending on one of this router's buses should not forward
+   * messages received on that same bus.
+   * @return route_item - route item from the linked list that must be stored
+   * in a variable
+   * @throws hal::argument_out_of_domain - if p_source_bus is neither any_bus
+   * nor less than max_buses.
+   * @throws hal::resource_unavailable_try_again - if the router is indexed and
+   * the index storage is full.
+   */
+  [[nodiscard]] route_item add_forward(hal::can::id_t p_id,
+                                       can_forwarder& p_forwarder,
+                                       std::uint8_t p_source_bus = any_bus);
+
+  /**
+   * @brief Forward messages whose masked ID matches a value to another bus
+   *
+   * @param p_match - value and mask that the message ID must match
+   * @param p_forwarder - forwarder sending to the destination bus. Must
+   * outlive the route.
+   * @param p_source_bus - bus to forward messages from, or any_bus
+   * @return route_item - route item from the linked list that must be stored
+   * in a variable
+   * @throws hal::argument_out_of_domain - if p_source_bus is neither any_bus
+   * nor less than max_buses.
+   * @throws hal::resource_unavailable_try_again - if the router is indexed and
+   * the index storage is full.
+   */
+  [[nodiscard]] route_item add_forward(id_mask p_match,
+                                       can_forwarder& p_forwarder,
+                                       std::uint8_t p_source_bus = any_bus);
+
+  /**
+   * @brief Reassemble ISO-TP messages received with a specific ID
+   *
+   * The route always runs from the receive handler, even while dispatch is
+   * deferred, so that flow control frames are answered without waiting for
+   * poll().
+   *
+   * @param p_id - ID the transmitter sends its frames with
+   * @param p_receiver - receiver reassembling the messages. Must outlive the
+   * route.
+   * @return route_item - route item from the linked list that must be stored
+   * in a variable
+   * @throws hal::resource_unavailable_try_again - if the router is indexed and
+   * the index storage is full.
+   */
+  [[nodiscard]] route_item add_isotp(hal::can::id_t p_id,
+                                     can_isotp_receiver& p_receiver);
+
+  /**
+   * @brief Supervise the reception of messages with a specific ID
+   *
+   * The route always runs from the receive handler, even while dispatch is
+   * deferred, so messages waiting in the queue still count as received. It
+   * may share its ID with the routes that consume the messages.
+   *
+   * @param p_id - ID of the supervised messages
+   * @param p_timeout - timeout restarted by each message. Must outlive the
+   * route.
+   * @return route_item - route item from the linked list that must be stored
+   * in a variable
+   * @throws hal::resource_unavailable_try_again - if the router is indexed and
+   * the index storage is full.
+   */
+  [[nodiscard]] route_item add_timeout(hal::can::id_t p_id,
+                                       can_timeout& p_timeout);
 
   /**
    * @brief Get the list of handlers
@@ -96,18 +730,390 @@ public:
    */
   [[nodiscard]] const static_list<route>& handlers();
 
+  /**
+   * @brief Get the list of thin route handlers
+   *
+   * The counterpart of handlers() for routes added with add_thin_route().
+   *
+   * @return const auto& map of all of the thin route handlers.
+   */
+  [[nodiscard]] const static_list<thin_route>& thin_handlers();
+
+  /**
+   * @brief Get the sorted route index
+   *
+   * Meant for testing purposes. The span is empty if this router was not
+   * constructed with index storage.
+   *
+   * @return std::span<const index_entry> - active portion of the index
+   */
+  [[nodiscard]] std::span<const index_entry> index() const;
+
+  /**
+   * @brief Compute hardware acceptance filters for the registered routes
+   *
+   * Produces at most `p_filters.size()` mask filters that together accept
+   * every message routed by this router. Range routes are split into aligned
+   * blocks. When there are more blocks than filters, the pair of filters whose
+   * merge accepts the fewest additional IDs is merged until the set fits.
+   *
+   * The result is meant to be programmed into the CAN peripheral's acceptance
+   * filters, through that peripheral's driver, so that unrouted messages never
+   * raise a receive interrupt. An empty result means that no message needs to
+   * be accepted. While an unrouted callback is set, the result is one filter
+   * accepting every message.
+   *
+   * @param p_filters - storage for the filters, typically one element per
+   * hardware filter bank.
+   * @param p_bus - bus to compute the filters for, skipping routes that only
+   * receive from other buses, or any_bus for the routes of every bus.
+   * @return std::span<acceptance_filter> - portion of p_filters that was filled
+   */
+  [[nodiscard]] std::span<acceptance_filter> acceptance_filters(
+    std::span<acceptance_filter> p_filters,
+    std::uint8_t p_bus = any_bus) const;
+
+  /**
+   * @brief Set a callback for messages that match no route
+   *
+   * Meant for passive bus monitoring or for forwarding unknown traffic. The
+   * callback only runs after the search for routes has failed, so routed
+   * messages are not slowed down by it. While it is set, acceptance_filters()
+   * accepts every message.
+   *
+   * @param p_handler - callback to be executed when an unrouted message is
+   * received.
+   * @param p_dispatch - context the handler runs in while dispatch is deferred
+   */
+  void on_unrouted(message_handler p_handler,
+                   dispatch_mode p_dispatch = dispatch_mode::deferred);
+
+  /**
+   * @brief Remove the callback for messages that match no route
+   *
+   */
+  void clear_unrouted();
+
+  /**
+   * @return std::uint32_t - number of received messages that matched no route,
+   * whether or not an unrouted callback is set. Wraps on overflow.
+   */
+  [[nodiscard]] std::uint32_t unrouted_count() const;
+
   /**
    * @brief Message routing interrupt service handler
    *
-   * Searches the static list and finds the first ID associated with the message
-   * and run's that route's callback.
+   * Searches the static list (or the sorted index, if present) and runs the
+   * callback of every route matching the message's ID. Indexed routers run
+   * exact ID routes before mask and range routes, otherwise routes run in the
+   * order they were registered.
    *
    * @param p_message - message received from the bus
    */
   void operator()(const can::message_t& p_message);
 
+  /**
+   * @brief Route a burst of messages
+   *
+   * Meant for drivers that drain several frames from a receive FIFO per
+   * interrupt and can call the router directly. Equivalent to calling the
+   * receive handler for each message in order, except that consecutive
+   * messages with the same ID reuse the previous lookup.
+   *
+   * Handlers must not add or remove routes while a burst is being dispatched.
+   *
+   * @param p_messages - messages received from the bus, oldest first
+   * @param p_bus - bus the messages were received on
+   */
+  void dispatch(std::span<const can::message_t> p_messages,
+                std::uint8_t p_bus = 0);
+
+  /**
+   * @brief Route a classic or CAN FD frame without copying it
+   *
+   * Meant for drivers that can hand over a view of their receive buffer.
+   * Classic frames are handled as by the receive handler, and routes with a
+   * `frame_handler` running from this call are given the view. CAN FD frames
+   * only run routes with a `frame_handler`, always from this call since the
+   * view does not outlive it. Route policies apply to both. A CAN FD frame
+   * matching no route with a `frame_handler` is counted as unrouted, but not
+   * given to the unrouted callback.
+   *
+   * @param p_frame - frame received from the bus
+   * @param p_bus - bus the frame was received on
+   */
+  void dispatch(const can_frame& p_frame, std::uint8_t p_bus = 0);
+
+  /**
+   * @brief Cache the lookups of frequently received IDs
+   *
+   * Each cache line remembers the exact ID routes of one ID and whether any
+   * mask or range route matches it, so a cached ID skips both the binary
+   * search and the search of the mask and range routes. Lines are searched
+   * from the front and a hit swaps the line with the one before it, so the
+   * most frequently received IDs gather at the front of the cache. A miss
+   * replaces the last line. IDs with no route are cached too.
+   *
+   * The cache is only used by the receive handler and dispatch(), and is
+   * cleared whenever a route is added or removed. Linear routers must visit
+   * every route to deliver a message and ignore the cache.
+   *
+   * @param p_cache - storage for the cache, typically 4 to 8 lines, or an
+   * empty span to disable it. Must outlive the router or be replaced before it
+   * is destroyed.
+   */
+  void cache_hot_routes(std::span<hot_route> p_cache);
+
+  /**
+   * @brief Reject messages with no route before searching for routes
+   *
+   * The filter is rebuilt from the current routes and kept up to date as
+   * routes are added. Unrouted standard IDs are then rejected with one bit
+   * test and most unrouted extended IDs with two. Mask and range routes that
+   * may match extended IDs make the filter pass every extended ID.
+   *
+   * An indexed router also updates the filter when a route is removed. A
+   * linear router is not told when routes are removed, so their IDs keep
+   * passing the filter and are searched for as before. Passing the filter
+   * again rebuilds it.
+   *
+   * @param p_filter - filter to maintain, or nullptr to stop filtering. Must
+   * outlive the router or be replaced before it is destroyed.
+   */
+  void filter_unrouted(id_filter* p_filter);
+
+  /**
+   * @brief Allow routes to be added and removed while messages are received
+   *
+   * The index is double buffered: changes are made to a working copy that is
+   * published with a single atomic store, and the receive handler always
+   * searches a complete, consistent copy. The receive handler is never
+   * blocked or masked. After publishing, the context making the change waits
+   * for a receive handler that is still searching the previous copy to
+   * return.
+   *
+   * Routes must be added and removed from a single context that the receive
+   * handler can preempt, such as the main loop or one task, and never from a
+   * route handler running in the receive handler. Moving a route_item
+   * relocates its route and is not covered: keep route items where
+   * add_message_callback() constructed them. Linear routers cannot be
+   * updated while messages are received.
+   *
+   * @param p_spare_storage - second buffer for the index, the same size as the
+   * index storage. Must outlive the router.
+   * @throws hal::argument_out_of_domain - if the router is not indexed or
+   * p_spare_storage is not the same size as the index storage.
+   */
+  void allow_live_updates(std::span<index_entry> p_spare_storage);
+
+  /**
+   * @brief Defer dispatch of received messages to poll()
+   *
+   * While a queue is set, the receive handler runs routes marked
+   * `dispatch_mode::immediate` and only copies messages for every other route
+   * into the queue, keeping those handlers out of interrupt context. Messages
+   * that match no route are dropped without being queued. The router is the
+   * queue's producer and poll() is its consumer.
+   *
+   * Each bus is deferred separately and needs a queue of its own, since each
+   * bus's receive handler is a separate producer.
+   *
+   * Routes may also be spread over several execution contexts, such as the
+   * cores of a multicore part, through `route::context`. Each context has its
+   * own queue for each bus and runs its routes from poll_context(). A message
+   * is queued once for every context with a matching deferred route, and
+   * routes of a context without a queue for the bus run from the receive
+   * handler.
+   *
+   * @param p_queue - queue for received messages, or nullptr to return to
+   * dispatching from the receive handler. Must outlive the router or be
+   * replaced before it is destroyed.
+   * @param p_bus - bus whose dispatch is deferred
+   * @param p_context - execution context whose routes are deferred
+   * @throws hal::argument_out_of_domain - if no bus has the number p_bus, or
+   * p_context is not less than max_contexts.
+   */
+  void defer_dispatch(can_message_queue* p_queue,
+                      std::uint8_t p_bus = 0,
+                      std::uint8_t p_context = 0);
+
+  /**
+   * @brief Dispatch messages held in the deferred dispatch queue
+   *
+   * Must be called from a single context, such as the main loop or one task.
+   * Does nothing if dispatch is not deferred. The queues of several buses are
+   * taken from in turn, one message at a time. Only runs the routes of
+   * execution context 0, as poll_context(0) does.
+   *
+   * @param p_max_messages - maximum number of messages to dispatch
+   * @return std::size_t - number of messages dispatched
+   */
+  std::size_t poll(
+    std::size_t p_max_messages = std::numeric_limits<std::size_t>::max());
+
+  /**
+   * @brief Dispatch the messages queued for one execution context
+   *
+   * Each context must be polled from a single thread of execution, and
+   * different contexts may be polled at the same time, for example one from
+   * each core. Routes must not be added or removed while a context other than
+   * the one changing them is polling. Queue storage shared between cores must
+   * be coherent between them, which on parts with a data cache usually means
+   * placing it in non-cacheable memory.
+   *
+   * @param p_context - execution context to dispatch the routes of
+   * @param p_max_messages - maximum number of messages to dispatch
+   * @return std::size_t - number of messages dispatched
+   */
+  std::size_t poll_context(
+    std::uint8_t p_context,
+    std::size_t p_max_messages = std::numeric_limits<std::size_t>::max());
+
+  /**
+   * @brief Record every received message into a capture ring
+   *
+   * Messages are recorded by the receive handler and dispatch() as they
+   * arrive, before any route runs, whether or not a route matches them.
+   * Messages dispatched later by poll() are not recorded again. CAN FD frames
+   * do not fit a record and are counted by the capture as skipped.
+   *
+   * @param p_capture - ring to record into, or nullptr to stop capturing.
+   * Must outlive the router or be replaced before it is destroyed.
+   */
+  void capture(can_capture* p_capture);
+
+#if LIBHAL_CANROUTER_INSTRUMENTATION
+  /**
+   * @brief Set the clock used to time handlers
+   *
+   * Without a clock, messages and handler runs are still counted but no times
+   * are recorded. Reading the clock twice per handler run adds to the time
+   * spent in the receive handler, so a clock with a cheap uptime() is
+   * preferred.
+   *
+   * @param p_clock - clock to time handlers with, or nullptr to stop timing.
+   * Must outlive the router or be replaced before it is destroyed.
+   */
+  void instrument(hal::steady_clock* p_clock);
+
+  /**
+   * @brief Get the router wide dispatch statistics
+   *
+   * Per route statistics are held within each route and can be read through
+   * handlers(), thin_handlers() or route_item::get(). Counters are updated
+   * from the receive handler without synchronization, so reads from another
+   * context may observe a partially updated set.
+   *
+   * @return router_statistics - counts of received and unrouted messages
+   */
+  [[nodiscard]] router_statistics statistics() const;
+
+  /**
+   * @brief Clear the statistics of the router and every route
+   *
+   */
+  void reset_statistics();
+#endif
+
 private:
+  /// Portion of the index storage the receive handler searches
+  struct index_view
+  {
+    std::span<const index_entry> exact{};
+    std::span<const index_entry> wildcards{};
+    std::size_t standard_size = 0;
+    std::uint32_t generation = 1;
+  };
+
+  [[nodiscard]] route_group find_group(const index_view& p_view,
+                                       hal::can::id_t p_id);
+  [[nodiscard]] route_group lookup(const index_view& p_view,
+                                   hal::can::id_t p_id);
+  template<class Callable>
+  bool for_each_route(const index_view& p_view,
+                      hal::can::id_t p_id,
+                      std::uint8_t p_bus,
+                      route_group p_group,
+                      Callable&& p_callable);
+  bool begin_dispatch();
+  void end_dispatch(bool p_live);
+  void receive(std::uint8_t p_bus, const can::message_t& p_message);
+  void deliver(const index_view& p_view,
+               const can::message_t& p_message,
+               route_group p_group);
+  template<class Callable>
+  static auto visit(const index_entry& p_entry, Callable&& p_callable);
+  template<class Route>
+  bool admits(Route& p_route, const can::message_t& p_message);
+  template<class Route>
+  bool admits(Route& p_route, const can_frame& p_frame);
+  template<class Route>
+  void invoke(Route& p_route, const can::message_t& p_message);
+  template<class Route>
+  void invoke(Route& p_route, const can_frame& p_frame);
+  template<class Route>
+  void handle(Route& p_route, const can::message_t& p_message);
+  template<class Route, class Callable>
+  void run(Route& p_route, Callable&& p_handler);
+  void deliver_unrouted(const can::message_t& p_message);
+  template<class Route>
+  [[nodiscard]] bool defers(const Route& p_route, std::uint8_t p_bus) const;
+  void push_deferred(std::uint32_t p_contexts,
+                     std::uint8_t p_bus,
+                     const can::message_t& p_message);
+  void listen(std::uint8_t p_bus);
+  template<class Route>
+  basic_route_item<Route> insert_route(static_list<Route>& p_list,
+                                       Route&& p_route);
+  template<class Route>
+  void index_insert(basic_route_item<Route>& p_item);
+  template<class Route>
+  void index_erase(basic_route_item<Route>& p_item);
+  template<class Route>
+  void index_relocate(basic_route_item<Route>& p_from,
+                      basic_route_item<Route>& p_to);
+  template<class Route>
+  index_entry* index_find(const Route& p_route, const void* p_owner);
+  static void link_owner(const index_entry& p_entry, can_router* p_router);
+  std::span<index_entry> wildcard_index();
+  void release_route_items();
+  void refresh_standard_table(std::size_t p_from);
+  void publish_index();
+  void forget_hot_routes();
+  void rebuild_id_filter();
+
   static_list<route> m_handlers{};
-  hal::can* m_can = nullptr;
+  static_list<thin_route> m_thin_handlers{};
+  std::span<index_entry> m_index{};
+  std::size_t m_index_size = 0;
+  std::size_t m_wildcard_size = 0;
+  std::size_t m_standard_size = 0;
+  std::span<index_entry> m_spare_index{};
+  std::array<index_view, 2> m_views{};
+  std::atomic<const index_view*> m_view = &m_views[0];
+  std::atomic<bool> m_live_updates = false;
+  std::atomic<bool> m_dispatching = false;
+  standard_id_table* m_standard_table = nullptr;
+  std::span<hot_route> m_hot_routes{};
+  id_filter* m_id_filter = nullptr;
+  route m_unrouted{};
+  std::uint32_t m_unrouted_count = 0;
+  bool m_has_unrouted = false;
+  std::array<std::array<can_message_queue*, max_contexts>, max_buses>
+    m_deferred_queues{};
+  /// Bit mask of the contexts with a queue, for each bus
+  std::array<std::uint8_t, max_buses> m_deferred_contexts{};
+  std::array<hal::can*, max_buses> m_buses{};
+  std::uint8_t m_bus_count = 0;
+  std::uint8_t m_source_bus = 0;
+  std::array<std::uint8_t, max_contexts> m_context_buses{};
+  can_capture* m_capture = nullptr;
+#if LIBHAL_CANROUTER_INSTRUMENTATION
+  std::uint32_t m_received_count = 0;
+  hal::steady_clock* m_clock = nullptr;
+#endif
 };
+
+extern template class can_router::basic_route_item<can_router::route>;
+extern template class can_router::basic_route_item<can_router::thin_route>;
 }  // namespace hal
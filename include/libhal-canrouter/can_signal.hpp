@@ -0,0 +1,230 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include <libhal/can.hpp>
+#include <libhal/functional.hpp>
+
+namespace hal {
+/**
+ * @brief Order of the bytes of a signal within a payload
+ *
+ */
+enum class can_byte_order : std::uint8_t
+{
+  /// Intel order, least significant byte first
+  little_endian,
+  /// Motorola order, most significant byte first
+  big_endian,
+};
+
+/**
+ * @brief Layout of one signal within a CAN payload, as described in a DBC
+ *
+ * Meant to be used as a template argument so that the shifts and masks that
+ * extract the signal are computed at compile time.
+ */
+struct can_signal
+{
+  /// Bit numbered as in a DBC file, `byte * 8 + bit` with bit 0 the least
+  /// significant bit of its byte. The least significant bit of a little
+  /// endian signal, the most significant bit of a big endian one.
+  std::uint8_t start = 0;
+  /// Number of bits, from 1 to 64
+  std::uint8_t length = 1;
+  can_byte_order order = can_byte_order::little_endian;
+  /// Whether the raw value is two's complement
+  bool is_signed = false;
+  /// Physical value is `raw * scale + offset`
+  double scale = 1.0;
+  double offset = 0.0;
+};
+
+/**
+ * @brief Extract the raw bits of a signal
+ *
+ * @tparam Signal - layout of the signal
+ * @param p_message - message holding the signal. Bytes beyond its length read
+ * as whatever the payload holds.
+ * @return std::uint64_t - raw value, zero extended
+ */
+template<can_signal Signal>
+[[nodiscard]] constexpr std::uint64_t can_signal_raw(
+  const can::message_t& p_message)
+{
+  static_assert(Signal.length >= 1 && Signal.length <= 64,
+                "A signal must be between 1 and 64 bits long");
+
+  constexpr std::uint64_t mask = Signal.length == 64
+                                   ? ~std::uint64_t{ 0 }
+                                   : (std::uint64_t{ 1 } << Signal.length) - 1;
+  std::uint64_t word = 0;
+
+  if constexpr (Signal.order == can_byte_order::little_endian) {
+    static_assert(Signal.start + Signal.length <= 64,
+                  "A little endian signal must end within the payload");
+    for (std::size_t i = 0; i < p_message.payload.size(); i++) {
+      word |= std::uint64_t{ p_message.payload[i] } << (8 * i);
+    }
+    return (word >> Signal.start) & mask;
+  } else {
+    // Position of the most significant bit, counted from the first bit sent
+    constexpr std::size_t msb = (Signal.start / 8 * 8) + (7 - Signal.start % 8);
+    static_assert(msb + Signal.length <= 64,
+                  "A big endian signal must end within the payload");
+    for (std::size_t i = 0; i < p_message.payload.size(); i++) {
+      word |= std::uint64_t{ p_message.payload[i] } << (56 - (8 * i));
+    }
+    return (word >> (64 - msb - Signal.length)) & mask;
+  }
+}
+
+/**
+ * @brief Decode the physical value of a signal
+ *
+ * Signed raw values are sign extended with shifts, and the scale and offset
+ * are only applied when they change the value, so the extraction has no
+ * branches.
+ *
+ * @tparam Signal - layout of the signal
+ * @tparam T - type of the physical value, converted with static_cast
+ * @param p_message - message holding the signal
+ * @return T - physical value of the signal
+ */
+template<can_signal Signal, class T = double>
+[[nodiscard]] constexpr T can_signal_decode(const can::message_t& p_message)
+{
+  auto const raw = can_signal_raw<Signal>(p_message);
+
+  if constexpr (Signal.is_signed) {
+    constexpr auto unused = 64 - Signal.length;
+    auto const value = static_cast<std::int64_t>(raw << unused) >> unused;
+    if constexpr (Signal.scale == 1.0 && Signal.offset == 0.0) {
+      return static_cast<T>(value);
+    } else {
+      return static_cast<T>((static_cast<double>(value) * Signal.scale) +
+                            Signal.offset);
+    }
+  } else if constexpr (Signal.scale == 1.0 && Signal.offset == 0.0) {
+    return static_cast<T>(raw);
+  } else {
+    return static_cast<T>((static_cast<double>(raw) * Signal.scale) +
+                          Signal.offset);
+  }
+}
+
+/**
+ * @brief Binds a signal to a data member of a decoded struct
+ *
+ * @tparam Member - pointer to the data member receiving the physical value
+ * @tparam Signal - layout of the signal
+ */
+template<auto Member, can_signal Signal>
+struct can_field
+{
+  template<class Struct>
+  static constexpr void decode_into(Struct& p_value,
+                                    const can::message_t& p_message)
+  {
+    using field_t = std::remove_cvref_t<decltype(p_value.*Member)>;
+    p_value.*Member = can_signal_decode<Signal, field_t>(p_message);
+  }
+};
+
+/**
+ * @brief Layout of a message decoded into a struct
+ *
+ * Only the listed fields are decoded, so a layout may list just the signals an
+ * application reads. Every other member keeps its default value.
+ *
+ *     struct motor_status { float speed; std::int16_t current; };
+ *     using motor_status_layout = hal::can_message_layout<
+ *       motor_status,
+ *       hal::can_field<&motor_status::speed,
+ *                      hal::can_signal{ .start = 0, .length = 16,
+ *                                       .scale = 0.1 }>,
+ *       hal::can_field<&motor_status::current,
+ *                      hal::can_signal{ .start = 16, .length = 12,
+ *                                       .is_signed = true }>>;
+ *
+ * @tparam T - struct receiving the decoded values
+ * @tparam Fields - can_field of each decoded member
+ */
+template<class T, class... Fields>
+struct can_message_layout
+{
+  using value_type = T;
+
+  /**
+   * @param p_message - message to decode
+   * @return T - struct with every listed field decoded
+   */
+  [[nodiscard]] static constexpr T decode(const can::message_t& p_message)
+  {
+    T value{};
+    (Fields::decode_into(value, p_message), ...);
+    return value;
+  }
+};
+
+/**
+ * @brief Route handler that decodes messages before handing them on
+ *
+ * Meant to be registered as a route handler, for example with
+ * `router.add_message_callback(id, std::ref(decoder))`, so that the
+ * application's handler receives the decoded struct instead of the raw
+ * payload.
+ *
+ * @tparam Layout - can_message_layout of the messages
+ */
+template<class Layout>
+class can_decoder
+{
+public:
+  using value_type = typename Layout::value_type;
+  using decoded_handler = void(const value_type& p_value);
+
+  /**
+   * @brief Construct a new decoder
+   *
+   * @param p_handler - callback to be executed with each decoded message
+   */
+  explicit can_decoder(hal::callback<decoded_handler> p_handler)
+    : m_handler(std::move(p_handler))
+  {
+  }
+
+  can_decoder(can_decoder& p_other) = delete;
+  can_decoder& operator=(can_decoder& p_other) = delete;
+
+  /**
+   * @brief Decode a message and pass it to the handler
+   *
+   * @param p_message - message received for the route
+   */
+  void operator()(const can::message_t& p_message)
+  {
+    m_handler(Layout::decode(p_message));
+  }
+
+private:
+  hal::callback<decoded_handler> m_handler;
+};
+}  // namespace hal
@@ -0,0 +1,167 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <span>
+
+#include <libhal/can.hpp>
+#include <libhal/functional.hpp>
+
+#include "can_placement.hpp"
+
+namespace hal {
+class can_timeout;
+
+/**
+ * @brief Hashed timer wheel tracking the reception deadlines of many IDs
+ *
+ * Time advances one tick per call to tick(), typically from a periodic timer
+ * interrupt or task. A can_timeout is kept in the slot of its next deadline,
+ * so each tick only visits the timeouts whose deadline falls on that slot,
+ * regardless of how many are supervised.
+ *
+ * Receiving a message only records the current tick in its can_timeout. The
+ * wheel is reorganized solely by tick(), so the receive handler never touches
+ * the wheel's lists and needs no lock. When a deadline is reached, the wheel
+ * checks whether a message arrived in the meantime and either moves the
+ * timeout to its new deadline or reports it as expired.
+ */
+class can_timeout_wheel
+{
+public:
+  /**
+   * @brief Construct a new timer wheel
+   *
+   * @param p_slots - storage for the wheel's slots. Must outlive the wheel.
+   * More slots mean fewer timeouts are visited per tick. Timeouts longer than
+   * the number of slots are supported.
+   * @throws hal::argument_out_of_domain - if the number of slots is not a
+   * power of two.
+   */
+  explicit can_timeout_wheel(std::span<can_timeout*> p_slots);
+
+  can_timeout_wheel(can_timeout_wheel& p_other) = delete;
+  can_timeout_wheel& operator=(can_timeout_wheel& p_other) = delete;
+
+  /**
+   * @brief Advance time by one tick and handle the deadlines that fall on it
+   *
+   * Timeout callbacks run from here and may construct, destroy or restart
+   * timeouts. Must be called from a single context, which is also the only
+   * context that may construct, destroy or restart timeouts.
+   */
+  void tick();
+
+  /**
+   * @return std::uint32_t - number of ticks since construction. Wraps on
+   * overflow.
+   */
+  [[nodiscard]] std::uint32_t now() const;
+
+private:
+  friend class can_timeout;
+
+  void schedule(can_timeout& p_timeout, std::uint32_t p_deadline);
+  void remove(can_timeout& p_timeout);
+
+  std::span<can_timeout*> m_slots;
+  can_timeout* m_pending = nullptr;
+  std::atomic<std::uint32_t> m_now = 0;
+};
+
+/**
+ * @brief Reports when messages for a route stop arriving
+ *
+ * Meant to be registered as a route, for example with
+ * `can_router::add_timeout()`, alongside the routes that consume the same ID.
+ * Each received message restarts the timeout. When no message arrives for the
+ * timeout's length, its callback runs once from can_timeout_wheel::tick(),
+ * and runs again only after messages have resumed and stopped once more.
+ */
+class can_timeout
+{
+public:
+  using timeout_handler = void();
+
+  /**
+   * @brief Construct a new timeout and start supervising
+   *
+   * The first deadline is one timeout's length after construction. Must be
+   * constructed from the context calling the wheel's tick().
+   *
+   * @param p_wheel - wheel tracking the deadline. Must outlive the timeout.
+   * @param p_length - ticks without a message before the timeout expires,
+   * typically a few times the period of the supervised message. Must not be
+   * zero.
+   * @param p_handler - callback to be executed when the timeout expires
+   * @throws hal::argument_out_of_domain - if p_length is zero.
+   */
+  can_timeout(can_timeout_wheel& p_wheel,
+              std::uint32_t p_length,
+              hal::callback<timeout_handler> p_handler);
+
+  can_timeout(can_timeout& p_other) = delete;
+  can_timeout& operator=(can_timeout& p_other) = delete;
+
+  /**
+   * @brief Stop supervising
+   *
+   * Must be destroyed from the context calling the wheel's tick().
+   */
+  ~can_timeout();
+
+  /**
+   * @brief Restart the timeout on reception of a message
+   *
+   * Only records the current tick, so it is safe and constant time to call
+   * from the receive handler.
+   *
+   * @param p_message - message received for the supervised route
+   */
+  void operator()(const can::message_t& p_message);
+
+  /**
+   * @brief Restart the timeout as if a message had been seen at a given tick
+   *
+   * Clears the expired state, so the callback runs again once the timeout's
+   * length has passed since p_since. Unlike operator(), this moves the
+   * timeout within the wheel and must be called from the context calling the
+   * wheel's tick(), which includes the timeout's own callback.
+   *
+   * @param p_since - tick to measure the next deadline from. Must not be in
+   * the future.
+   */
+  void restart(std::uint32_t p_since);
+
+  /**
+   * @return true - if the timeout has expired and no message has been seen
+   * at a deadline since
+   */
+  [[nodiscard]] bool expired() const;
+
+private:
+  friend class can_timeout_wheel;
+
+  can_timeout_wheel* m_wheel = nullptr;
+  hal::callback<timeout_handler> m_handler;
+  can_timeout* m_next = nullptr;
+  std::uint32_t m_length = 0;
+  std::uint32_t m_deadline = 0;
+  std::atomic<std::uint32_t> m_last_seen = 0;
+  bool m_expired = false;
+};
+}  // namespace hal
@@ -0,0 +1,127 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+
+#include <libhal/can.hpp>
+#include <libhal/functional.hpp>
+
+namespace hal {
+/**
+ * @brief Priority ordered queue of messages waiting to be sent on a bus
+ *
+ * Meant to replace busy waiting on, or dropping frames at, a peripheral whose
+ * transmit mailboxes are full. Callers queue messages with send(), which never
+ * blocks, and the queue is drained into the peripheral by drain(), typically
+ * from the peripheral's transmit complete interrupt and once after queueing.
+ *
+ * Messages leave in the order the bus would arbitrate them: lowest ID first,
+ * with a standard ID ahead of an extended ID sharing its 11 base bits.
+ * Queueing a message with the same ID and type as one still waiting replaces
+ * that message's contents, so only the newest payload is sent.
+ *
+ * send() and drain() may be called from different contexts, such as control
+ * loops queueing messages while the transmit complete interrupt drains them.
+ * Both change the queue only within the critical section given to the
+ * constructor, which should mask every context that calls the other, for
+ * example by disabling the transmit interrupt.
+ */
+class can_transmit_queue
+{
+public:
+  /**
+   * @brief Called with true to enter a critical section and with false to
+   * leave it
+   */
+  using critical_section = hal::callback<void(bool p_enter)>;
+
+  /**
+   * @brief Construct a new can transmit queue
+   *
+   * @param p_bus - bus to send messages on. Must outlive the queue.
+   * @param p_storage - storage for waiting messages. Must outlive the queue.
+   * @param p_critical_section - entered by send() and drain() while they
+   * change the queue. The default does nothing, for queues used from a single
+   * context.
+   * @throws hal::argument_out_of_domain - if p_storage is empty
+   */
+  can_transmit_queue(
+    hal::can& p_bus,
+    std::span<can::message_t> p_storage,
+    critical_section p_critical_section = [](bool) {});
+
+  can_transmit_queue(can_transmit_queue& p_other) = delete;
+  can_transmit_queue& operator=(can_transmit_queue& p_other) = delete;
+
+  /**
+   * @brief Queue a message to be sent
+   *
+   * @param p_message - message to send
+   * @return true - if the message was queued or replaced a waiting message
+   * with the same ID
+   * @return false - if the queue was full and the message was dropped
+   */
+  bool send(const can::message_t& p_message);
+
+  /**
+   * @brief Send waiting messages, highest priority first
+   *
+   * Stops early when the bus rejects a message, for example because its
+   * transmit mailboxes are full. That message stays at the front of the queue
+   * for the next call.
+   *
+   * @param p_max_messages - maximum number of messages to send
+   * @return std::size_t - number of messages sent
+   */
+  std::size_t drain(
+    std::size_t p_max_messages = std::numeric_limits<std::size_t>::max());
+
+  /**
+   * @return std::size_t - number of messages waiting to be sent
+   */
+  [[nodiscard]] std::size_t size() const;
+
+  /**
+   * @return std::size_t - maximum number of messages that can wait at once
+   */
+  [[nodiscard]] std::size_t capacity() const;
+
+  /**
+   * @return std::uint32_t - number of messages whose contents replaced those
+   * of a waiting message. Wraps on overflow.
+   */
+  [[nodiscard]] std::uint32_t coalesced_count() const;
+
+  /**
+   * @return std::uint32_t - number of messages dropped because the queue was
+   * full. Wraps on overflow.
+   */
+  [[nodiscard]] std::uint32_t overflow_count() const;
+
+private:
+  hal::can* m_bus = nullptr;
+  critical_section m_critical_section;
+  // Sorted from the lowest priority to the highest, so that the next message
+  // to send is removed from the back without moving the others.
+  std::span<can::message_t> m_storage;
+  std::size_t m_size = 0;
+  std::uint32_t m_coalesced_count = 0;
+  std::uint32_t m_overflow_count = 0;
+};
+}  // namespace hal
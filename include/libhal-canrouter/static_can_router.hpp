@@ -0,0 +1,381 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include <libhal/can.hpp>
+
+#include "can_router.hpp"
+
+namespace hal {
+/**
+ * @brief Number of index bits for the smallest table that fits p_count
+ *
+ * @param p_count - number of entries to be stored in the table
+ * @return std::uint32_t - log2 of the table size, never less than 1
+ */
+[[nodiscard]] constexpr std::uint32_t can_hash_table_bits(std::size_t p_count)
+{
+  std::uint32_t bits = 1;
+  while ((std::size_t{ 1 } << bits) < p_count) {
+    bits++;
+  }
+  return bits;
+}
+
+/**
+ * @brief Slot of a perfect hash table mapping a CAN ID to a route index
+ *
+ */
+struct can_hash_slot
+{
+  hal::can::id_t id = 0;
+  std::uint16_t route = 0;
+};
+
+/**
+ * @brief Two level perfect hash over a fixed set of CAN IDs
+ *
+ * An ID first selects a bucket using a fixed multiplicative hash. Each bucket
+ * has a seed that is mixed into the ID before a second multiplicative hash
+ * places it into the table. The table holds every ID with the index of its
+ * route, so a lookup is two multiplies, two loads and one compare.
+ *
+ * The table has at least twice as many slots as IDs, which keeps the search
+ * for seeds short.
+ *
+ * @tparam N - number of IDs in the set
+ */
+template<std::size_t N>
+struct can_perfect_hash
+{
+  static constexpr std::uint32_t bucket_bits = can_hash_table_bits((N + 1) / 2);
+  static constexpr std::uint32_t table_bits = can_hash_table_bits(2 * N);
+  static constexpr std::size_t bucket_count = std::size_t{ 1 } << bucket_bits;
+  static constexpr std::size_t table_size = std::size_t{ 1 } << table_bits;
+  static constexpr std::uint32_t bucket_multiplier = 0x9E37'79B1U;
+  static constexpr std::uint32_t slot_multiplier = 0x85EB'CA6BU;
+
+  std::array<std::uint32_t, bucket_count> seed{};
+  std::array<can_hash_slot, table_size> table{};
+  bool valid = false;
+
+  [[nodiscard]] static constexpr std::size_t bucket(hal::can::id_t p_id)
+  {
+    return static_cast<std::uint32_t>(p_id * bucket_multiplier) >>
+           (32U - bucket_bits);
+  }
+
+  [[nodiscard]] static constexpr std::size_t slot(hal::can::id_t p_id,
+                                                  std::uint32_t p_seed)
+  {
+    return static_cast<std::uint32_t>((p_id ^ p_seed) * slot_multiplier) >>
+           (32U - table_bits);
+  }
+
+  [[nodiscard]] constexpr std::size_t slot(hal::can::id_t p_id) const
+  {
+    return slot(p_id, seed[bucket(p_id)]);
+  }
+
+  /**
+   * @brief Look up the table slot for an ID
+   *
+   * @param p_id - ID to look up
+   * @return const can_hash_slot* - slot holding p_id or nullptr if p_id is not
+   * part of the set.
+   */
+  [[nodiscard]] constexpr const can_hash_slot* find(hal::can::id_t p_id) const
+  {
+    auto const& entry = table[slot(p_id)];
+    if (entry.id != p_id) {
+      return nullptr;
+    }
+    return &entry;
+  }
+};
+
+/**
+ * @brief Build a perfect hash for a set of CAN IDs
+ *
+ * Buckets are placed from largest to smallest. For each one, seeds are tried
+ * in order until every ID in the bucket lands in its own free slot.
+ *
+ * @param p_ids - unique set of IDs to hash
+ * @return can_perfect_hash<N> - perfect hash with `valid` set to false if
+ * p_ids contains duplicates or no seed could be found for a bucket.
+ */
+template<std::size_t N>
+[[nodiscard]] constexpr can_perfect_hash<N> make_can_perfect_hash(
+  const std::array<hal::can::id_t, N>& p_ids)
+{
+  using hash_t = can_perfect_hash<N>;
+  constexpr std::uint32_t max_attempts = 1024;
+  constexpr std::uint32_t seed_step = 0x9E37'79B9U;
+
+  hash_t result{};
+
+  auto sorted_ids = p_ids;
+  std::sort(sorted_ids.begin(), sorted_ids.end());
+  if (std::adjacent_find(sorted_ids.begin(), sorted_ids.end()) !=
+      sorted_ids.end()) {
+    return result;
+  }
+
+  std::array<std::size_t, hash_t::bucket_count> bucket_size{};
+  std::array<std::size_t, hash_t::bucket_count> order{};
+  std::array<bool, hash_t::table_size> occupied{};
+
+  for (auto const id : p_ids) {
+    bucket_size[hash_t::bucket(id)]++;
+  }
+  for (std::size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&](std::size_t p_a, std::size_t p_b) {
+    return bucket_size[p_a] > bucket_size[p_b];
+  });
+
+  for (auto const bucket : order) {
+    if (bucket_size[bucket] == 0) {
+      break;
+    }
+
+    bool placed = false;
+    for (std::uint32_t attempt = 0; attempt < max_attempts; attempt++) {
+      auto const candidate = attempt * seed_step;
+      std::array<std::size_t, N> slots{};
+      std::size_t count = 0;
+
+      for (auto const id : p_ids) {
+        if (hash_t::bucket(id) != bucket) {
+          continue;
+        }
+        auto const slot = hash_t::slot(id, candidate);
+        bool const taken =
+          occupied[slot] ||
+          std::find(slots.begin(), slots.begin() + count, slot) !=
+            slots.begin() + count;
+        if (taken) {
+          break;
+        }
+        slots[count++] = slot;
+      }
+
+      if (count != bucket_size[bucket]) {
+        continue;
+      }
+
+      for (std::size_t i = 0; i < count; i++) {
+        occupied[slots[i]] = true;
+      }
+      result.seed[bucket] = candidate;
+      placed = true;
+      break;
+    }
+
+    if (not placed) {
+      return result;
+    }
+  }
+
+  for (std::size_t i = 0; i < N; i++) {
+    result.table[result.slot(p_ids[i])] = can_hash_slot{
+      .id = p_ids[i],
+      .route = static_cast<std::uint16_t>(i),
+    };
+  }
+
+  // Unused slots are given an ID that hashes to some other slot, so that no ID
+  // can ever match them.
+  for (std::size_t i = 0; i < hash_t::table_size; i++) {
+    if (occupied[i]) {
+      continue;
+    }
+    hal::can::id_t unused_id = UINT32_MAX;
+    while (result.slot(unused_id) == i) {
+      unused_id--;
+    }
+    result.table[i].id = unused_id;
+  }
+
+  result.valid = true;
+  return result;
+}
+
+/**
+ * @brief Route CAN messages to callbacks using a table fixed at compile time
+ *
+ * The set of routed IDs is given as template arguments. A collision free hash
+ * over those IDs, and the table it indexes, are computed at compile time and
+ * stored as constants, allowing them to be placed in flash. Dispatching a
+ * message costs two multiplies, two table loads, one compare and the handler
+ * call.
+ *
+ * Only the handlers themselves are stored in RAM. Each ID starts with the noop
+ * handler and may be assigned a handler at runtime.
+ *
+ * Being a template, the router cannot be placed with the attributes of
+ * can_placement.hpp. To run it from fast memory, place the application
+ * function that calls it, into which the receive handler is inlined, and with
+ * `-fdata-sections` move the hash's `.rodata` sections from the linker script.
+ *
+ * @tparam Ids - unique set of CAN IDs to route
+ */
+template<hal::can::id_t... Ids>
+class static_can_router
+{
+public:
+  using message_handler = can_router::message_handler;
+
+  /**
+   * @brief Handler for one of the router's IDs
+   *
+   * Only exact IDs fixed at compile time are routed, and handlers always run
+   * in the receive handler. There is no mask, range, policy, frame handler,
+   * deferred dispatch or bus selection as there is for can_router::route.
+   */
+  struct route
+  {
+    /// ID the route receives, fixed by the router's template arguments
+    hal::can::id_t id = 0;
+    message_handler handler = can_router::noop;
+  };
+
+  static constexpr std::size_t route_count = sizeof...(Ids);
+  static constexpr std::array<hal::can::id_t, route_count> ids{ Ids... };
+  static constexpr can_perfect_hash<route_count> hash =
+    make_can_perfect_hash(ids);
+
+  static_assert(route_count > 0, "At least one CAN ID must be routed");
+  static_assert(route_count <= UINT16_MAX, "Too many CAN IDs for one router");
+  static_assert(((Ids <= 0x1FFF'FFFF) && ...),
+                "CAN IDs must fit within 29-bits");
+  static_assert(hash.valid,
+                "Could not find a collision free hash for this set of CAN "
+                "IDs. Check for duplicate IDs.");
+
+  /**
+   * @brief Construct a new static can message router
+   *
+   * @param p_can - can peripheral to route messages for
+   */
+  explicit static_can_router(hal::can& p_can)
+    : m_can(&p_can)
+  {
+    m_can->on_receive(std::ref(*this));
+  }
+
+  static_can_router() = delete;
+  static_can_router(static_can_router& p_other) = delete;
+  static_can_router& operator=(static_can_router& p_other) = delete;
+
+  static_can_router& operator=(static_can_router&& p_other) noexcept
+  {
+    m_routes = std::move(p_other.m_routes);
+    m_can = p_other.m_can;
+    m_can->on_receive(std::ref(*this));
+
+    p_other.m_can = nullptr;
+    return *this;
+  }
+
+  static_can_router(static_can_router&& p_other) noexcept
+  {
+    *this = std::move(p_other);
+  }
+
+  ~static_can_router()
+  {
+    if (m_can) {
+      m_can->on_receive(can_router::noop);
+    }
+  }
+
+  /**
+   * @brief Get a reference to the can peripheral driver
+   *
+   * @return can& reference to the can peripheral driver
+   */
+  [[nodiscard]] hal::can& bus()
+  {
+    return *m_can;
+  }
+
+  /**
+   * @brief Get the route for an ID known at compile time
+   *
+   * @tparam Id - ID of the route; must be one of the router's IDs
+   * @return route& - the route associated with Id
+   */
+  template<hal::can::id_t Id>
+  [[nodiscard]] route& get()
+  {
+    constexpr auto entry = hash.table[hash.slot(Id)];
+    static_assert(entry.id == Id, "ID is not routed by this router");
+    return m_routes[entry.route];
+  }
+
+  /**
+   * @brief Find the route for an ID at runtime
+   *
+   * @param p_id - ID of the route
+   * @return route* - the route associated with p_id or nullptr if this router
+   * does not route p_id.
+   */
+  [[nodiscard]] route* find(hal::can::id_t p_id)
+  {
+    auto const* entry = hash.find(p_id);
+    if (entry == nullptr) {
+      return nullptr;
+    }
+    return &m_routes[entry->route];
+  }
+
+  /**
+   * @brief Get the routes held by this router
+   *
+   * Routes are stored in the same order as the template ID arguments.
+   *
+   * @return const std::array<route, route_count>& - routes of this router
+   */
+  [[nodiscard]] const std::array<route, route_count>& routes() const
+  {
+    return m_routes;
+  }
+
+  /**
+   * @brief Message routing interrupt service handler
+   *
+   * @param p_message - message received from the bus
+   */
+  void operator()(const can::message_t& p_message)
+  {
+    auto const& entry = hash.table[hash.slot(p_message.id)];
+    if (entry.id == p_message.id) {
+      m_routes[entry.route].handler(p_message);
+    }
+  }
+
+private:
+  std::array<route, route_count> m_routes{ route{ .id = Ids }... };
+  hal::can* m_can = nullptr;
+};
+}  // namespace hal
@@ -0,0 +1,155 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libhal-canrouter/can_capture.hpp"
+
+#include <libhal/error.hpp>
+
+#include "ring_position.hpp"
+
+namespace hal {
+/**
+ * @brief Construct a new capture
+ *
+ * @param p_clock - clock to timestamp messages with. Must outlive the capture.
+ * @param p_storage - storage for the records. Must outlive the capture.
+ * @throws hal::argument_out_of_domain - if p_storage is empty
+ */
+can_capture::can_capture(hal::steady_clock& p_clock,
+                         std::span<record> p_storage)
+  : m_clock(&p_clock)
+  , m_storage(p_storage)
+{
+  if (m_storage.empty()) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+}
+
+/**
+ * @brief Append a message to the ring
+ *
+ * Called by the router from the receive handler. Must only be called from the
+ * producer context.
+ *
+ * @param p_bus - bus the message was received on
+ * @param p_message - message to record
+ * @return true - if the message was recorded
+ * @return false - if the ring was full and the message was dropped
+ */
+LIBHAL_CANROUTER_FAST_CODE
+bool can_capture::append(std::uint8_t p_bus, const can::message_t& p_message)
+{
+  ring_position const ring{ m_storage.size() };
+  auto const write = m_write.load(std::memory_order_relaxed);
+  auto const read = m_read.load(std::memory_order_acquire);
+
+  if (ring.distance(write, read) == m_storage.size()) {
+    m_overflow_count.store(
+      m_overflow_count.load(std::memory_order_relaxed) + 1,
+      std::memory_order_relaxed);
+    return false;
+  }
+
+  m_storage[ring.index(write)] = record{
+    .timestamp = static_cast<std::uint32_t>(m_clock->uptime()),
+    .id = p_message.id,
+    .payload = p_message.payload,
+    .length = p_message.length,
+    .bus = p_bus,
+    .is_remote_request = p_message.is_remote_request,
+  };
+  m_write.store(ring.advance(write), std::memory_order_release);
+  return true;
+}
+
+/**
+ * @brief Append a frame to the ring
+ *
+ * Called by the router from can_router::dispatch(). Classic frames are
+ * recorded as by the other overload. Must only be called from the producer
+ * context.
+ *
+ * @param p_bus - bus the frame was received on
+ * @param p_frame - frame to record
+ * @return true - if the frame was recorded
+ * @return false - if the ring was full, or the frame was a CAN FD frame and
+ * was skipped
+ */
+LIBHAL_CANROUTER_FAST_CODE
+bool can_capture::append(std::uint8_t p_bus, const can_frame& p_frame)
+{
+  auto const message = p_frame.classic();
+  if (not message) {
+    m_skipped_count.store(m_skipped_count.load(std::memory_order_relaxed) + 1,
+                          std::memory_order_relaxed);
+    return false;
+  }
+  return append(p_bus, *message);
+}
+
+/**
+ * @brief Remove the oldest records from the ring
+ *
+ * Must only be called from the consumer context.
+ *
+ * @param p_records - destination for the records
+ * @return std::size_t - number of records copied into p_records
+ */
+std::size_t can_capture::read(std::span<record> p_records)
+{
+  ring_position const ring{ m_storage.size() };
+  auto read = m_read.load(std::memory_order_relaxed);
+  auto const write = m_write.load(std::memory_order_acquire);
+  std::size_t count = 0;
+
+  for (auto& destination : p_records) {
+    if (read == write) {
+      break;
+    }
+    destination = m_storage[ring.index(read)];
+    read = ring.advance(read);
+    count++;
+  }
+
+  m_read.store(read, std::memory_order_release);
+  return count;
+}
+
+hal::hertz can_capture::frequency()
+{
+  return m_clock->frequency();
+}
+
+std::size_t can_capture::size() const
+{
+  return ring_position{ m_storage.size() }.distance(
+    m_write.load(std::memory_order_acquire),
+    m_read.load(std::memory_order_acquire));
+}
+
+std::size_t can_capture::capacity() const
+{
+  return m_storage.size();
+}
+
+std::uint32_t can_capture::overflow_count() const
+{
+  return m_overflow_count.load(std::memory_order_relaxed);
+}
+
+std::uint32_t can_capture::skipped_count() const
+{
+  return m_skipped_count.load(std::memory_order_relaxed);
+}
+}  // namespace hal
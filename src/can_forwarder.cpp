@@ -0,0 +1,133 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libhal-canrouter/can_forwarder.hpp"
+
+#include <chrono>
+#include <cmath>
+
+#include <libhal/error.hpp>
+
+namespace hal {
+/**
+ * @brief Construct a forwarder that keeps message IDs unchanged
+ *
+ * @param p_destination - bus to send forwarded messages on. Must outlive the
+ * forwarder.
+ */
+can_forwarder::can_forwarder(hal::can& p_destination)
+  : m_destination(&p_destination)
+{
+}
+
+/**
+ * @brief Construct a forwarder that rewrites message IDs
+ *
+ * @param p_destination - bus to send forwarded messages on. Must outlive the
+ * forwarder.
+ * @param p_rewrite - transform of the ID of forwarded messages
+ */
+can_forwarder::can_forwarder(hal::can& p_destination, id_rewrite p_rewrite)
+  : m_destination(&p_destination)
+  , m_rewrite(p_rewrite)
+{
+}
+
+/**
+ * @brief Limit how often messages are forwarded
+ *
+ * Messages received sooner than p_min_interval after the last forwarded
+ * message are suppressed and counted. A message the destination rejects
+ * does not count as forwarded.
+ *
+ * @param p_clock - clock to measure the interval with, or nullptr to forward
+ * every message. Must outlive the forwarder or be replaced before it is
+ * destroyed.
+ * @param p_min_interval - shortest time between two forwarded messages
+ */
+void can_forwarder::limit_rate(hal::steady_clock* p_clock,
+                               hal::time_duration p_min_interval)
+{
+  m_clock = p_clock;
+  m_rate_started = false;
+  m_min_interval = 0;
+
+  if (m_clock == nullptr || p_min_interval.count() <= 0) {
+    return;
+  }
+
+  // Converted to ticks once, so the receive handler only compares integers
+  auto const seconds = std::chrono::duration<double>(p_min_interval).count();
+  m_min_interval =
+    static_cast<std::uint64_t>(std::ceil(seconds * m_clock->frequency()));
+}
+
+/**
+ * @brief Forward a message to the destination bus
+ *
+ * A message that the destination rejects, for example because its transmit
+ * mailboxes are full, is dropped and counted rather than letting the error
+ * unwind through the receive handler.
+ *
+ * @param p_message - message to forward
+ */
+LIBHAL_CANROUTER_FAST_CODE
+void can_forwarder::operator()(const can::message_t& p_message)
+{
+  std::uint64_t now = 0;
+  if (m_clock) {
+    now = m_clock->uptime();
+    if (m_rate_started && now - m_last_forwarded < m_min_interval) {
+      m_suppressed_count++;
+      return;
+    }
+  }
+
+  try {
+    if (m_rewrite.keep == 0xFFFF'FFFF && m_rewrite.set == 0) {
+      m_destination->send(p_message);
+    } else {
+      auto message = p_message;
+      message.id = (message.id & m_rewrite.keep) | m_rewrite.set;
+      m_destination->send(message);
+    }
+  } catch (const hal::exception&) {
+    m_dropped_count++;
+    return;
+  }
+
+  // Only a sent message starts the interval, so a retry after a rejected send
+  // is not suppressed
+  if (m_clock) {
+    m_last_forwarded = now;
+    m_rate_started = true;
+  }
+  m_forwarded_count++;
+}
+
+std::uint32_t can_forwarder::forwarded_count() const
+{
+  return m_forwarded_count;
+}
+
+std::uint32_t can_forwarder::suppressed_count() const
+{
+  return m_suppressed_count;
+}
+
+std::uint32_t can_forwarder::dropped_count() const
+{
+  return m_dropped_count;
+}
+}  // namespace hal
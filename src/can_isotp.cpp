@@ -0,0 +1,321 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libhal-canrouter/can_isotp.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#include <libhal/error.hpp>
+
+namespace hal {
+namespace {
+/// Protocol control information, held in the upper nibble of the first byte
+enum class frame_type : std::uint8_t
+{
+  single = 0,
+  first = 1,
+  consecutive = 2,
+  flow_control = 3,
+};
+
+/// Flow status of a flow control frame
+constexpr std::uint8_t continue_to_send = 0;
+constexpr std::uint8_t overflow = 2;
+
+constexpr std::size_t max_message_length = 0xFFF;
+constexpr std::size_t first_frame_data = 6;
+constexpr std::size_t consecutive_frame_data = 7;
+constexpr hal::byte padding = 0xCC;
+
+/// Returns a buffer to its pool on leaving scope, even if a handler throws
+class release_on_exit
+{
+public:
+  LIBHAL_CANROUTER_FAST_CODE
+  release_on_exit(can_isotp_pool& p_pool, std::span<hal::byte> p_buffer)
+    : m_pool(&p_pool)
+    , m_buffer(p_buffer)
+  {
+  }
+
+  release_on_exit(release_on_exit& p_other) = delete;
+  release_on_exit& operator=(release_on_exit& p_other) = delete;
+
+  LIBHAL_CANROUTER_FAST_CODE
+  ~release_on_exit()
+  {
+    m_pool->release(m_buffer);
+  }
+
+private:
+  can_isotp_pool* m_pool;
+  std::span<hal::byte> m_buffer;
+};
+}  // namespace
+
+/**
+ * @brief Construct a new buffer pool
+ *
+ * @param p_storage - storage for the buffers. Must outlive the pool. Bytes
+ * beyond the last whole buffer, or beyond max_buffers buffers, are unused.
+ * @param p_buffer_size - size of each buffer, which is the longest message
+ * that can be reassembled. At most 4095 bytes are used.
+ * @throws hal::argument_out_of_domain - if p_storage cannot hold a single
+ * buffer of p_buffer_size bytes, or p_buffer_size is zero.
+ */
+can_isotp_pool::can_isotp_pool(std::span<hal::byte> p_storage,
+                               std::size_t p_buffer_size)
+  : m_storage(p_storage)
+  , m_buffer_size(p_buffer_size)
+{
+  if (m_buffer_size == 0 || m_storage.size() < m_buffer_size) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+  m_count = std::min(m_storage.size() / m_buffer_size, max_buffers);
+}
+
+/**
+ * @brief Take a free buffer from the pool
+ *
+ * @return std::span<hal::byte> - the buffer, or an empty span if every buffer
+ * is in use.
+ */
+LIBHAL_CANROUTER_FAST_CODE
+std::span<hal::byte> can_isotp_pool::acquire()
+{
+  auto const position = static_cast<std::size_t>(std::countr_one(m_in_use));
+  if (position >= m_count) {
+    return {};
+  }
+  m_in_use |= std::uint32_t{ 1 } << position;
+  return m_storage.subspan(position * m_buffer_size, m_buffer_size);
+}
+
+/**
+ * @brief Return a buffer to the pool
+ *
+ * @param p_buffer - buffer returned by acquire(). Empty spans are ignored.
+ */
+LIBHAL_CANROUTER_FAST_CODE
+void can_isotp_pool::release(std::span<hal::byte> p_buffer)
+{
+  if (p_buffer.empty()) {
+    return;
+  }
+  auto const offset =
+    static_cast<std::size_t>(p_buffer.data() - m_storage.data());
+  m_in_use &= ~(std::uint32_t{ 1 } << (offset / m_buffer_size));
+}
+
+std::size_t can_isotp_pool::buffer_size() const
+{
+  return m_buffer_size;
+}
+
+std::size_t can_isotp_pool::available() const
+{
+  return m_count - static_cast<std::size_t>(std::popcount(m_in_use));
+}
+
+/**
+ * @brief Construct a new ISO-TP receiver
+ *
+ * @param p_bus - bus to send flow control frames on. Must outlive the
+ * receiver.
+ * @param p_pool - pool to take reassembly buffers from. Must outlive the
+ * receiver.
+ * @param p_flow_control - parameters of the flow control frames
+ * @param p_handler - callback to be executed with each complete message
+ */
+can_isotp_receiver::can_isotp_receiver(hal::can& p_bus,
+                                       can_isotp_pool& p_pool,
+                                       flow_control p_flow_control,
+                                       hal::callback<payload_handler> p_handler)
+  : m_bus(&p_bus)
+  , m_pool(&p_pool)
+  , m_flow_control(p_flow_control)
+  , m_handler(std::move(p_handler))
+{
+}
+
+can_isotp_receiver::~can_isotp_receiver()
+{
+  m_pool->release(m_buffer);
+}
+
+/**
+ * @brief Process a frame received for this receiver's ID
+ *
+ * @param p_message - frame received from the bus
+ */
+LIBHAL_CANROUTER_FAST_CODE
+void can_isotp_receiver::operator()(const can::message_t& p_message)
+{
+  if (p_message.length == 0 || p_message.is_remote_request) {
+    return;
+  }
+
+  switch (static_cast<frame_type>(p_message.payload[0] >> 4U)) {
+    case frame_type::single:
+      receive_single(p_message);
+      break;
+    case frame_type::first:
+      receive_first(p_message);
+      break;
+    case frame_type::consecutive:
+      receive_consecutive(p_message);
+      break;
+    case frame_type::flow_control:
+    default:
+      // Flow control frames are meant for a transmitter
+      break;
+  }
+}
+
+std::uint32_t can_isotp_receiver::completed_count() const
+{
+  return m_completed_count;
+}
+
+std::uint32_t can_isotp_receiver::aborted_count() const
+{
+  return m_aborted_count;
+}
+
+LIBHAL_CANROUTER_FAST_CODE
+void can_isotp_receiver::receive_single(const can::message_t& p_message)
+{
+  std::size_t const length = p_message.payload[0] & 0xFU;
+  if (length == 0 || length + 1 > p_message.length) {
+    return;
+  }
+
+  // A new message ends any transfer in progress
+  if (not m_buffer.empty()) {
+    abort();
+  }
+
+  m_completed_count++;
+  m_handler(std::span(p_message.payload).subspan(1, length));
+}
+
+LIBHAL_CANROUTER_FAST_CODE
+void can_isotp_receiver::receive_first(const can::message_t& p_message)
+{
+  if (p_message.length < p_message.payload.size()) {
+    return;
+  }
+
+  std::size_t const length =
+    ((p_message.payload[0] & 0xFU) << 8U) | p_message.payload[1];
+  // Shorter messages must be sent as single frames
+  if (length <= consecutive_frame_data) {
+    return;
+  }
+
+  if (not m_buffer.empty()) {
+    abort();
+  }
+
+  auto const buffer =
+    length <= std::min(m_pool->buffer_size(), max_message_length)
+      ? m_pool->acquire()
+      : std::span<hal::byte>{};
+  if (buffer.empty()) {
+    send_flow_control(overflow);
+    m_aborted_count++;
+    return;
+  }
+
+  m_buffer = buffer;
+  m_expected = length;
+  std::copy_n(
+    p_message.payload.begin() + 2, first_frame_data, m_buffer.begin());
+  m_received = first_frame_data;
+  m_sequence = 1;
+  m_block_remaining = m_flow_control.block_size;
+
+  if (not send_flow_control(continue_to_send)) {
+    abort();
+  }
+}
+
+LIBHAL_CANROUTER_FAST_CODE
+void can_isotp_receiver::receive_consecutive(const can::message_t& p_message)
+{
+  if (m_buffer.empty()) {
+    return;
+  }
+
+  if ((p_message.payload[0] & 0xFU) != m_sequence) {
+    abort();
+    return;
+  }
+
+  auto const length = std::min<std::size_t>(
+    { consecutive_frame_data,
+      m_expected - m_received,
+      static_cast<std::size_t>(p_message.length - 1) });
+  std::copy_n(
+    p_message.payload.begin() + 1, length, m_buffer.begin() + m_received);
+  m_received += length;
+  m_sequence = (m_sequence + 1) & 0xFU;
+
+  if (m_received == m_expected) {
+    auto const buffer = m_buffer;
+    m_buffer = {};
+    m_completed_count++;
+    release_on_exit const release(*m_pool, buffer);
+    m_handler(buffer.first(m_expected));
+    return;
+  }
+
+  if (m_flow_control.block_size != 0 && --m_block_remaining == 0) {
+    m_block_remaining = m_flow_control.block_size;
+    if (not send_flow_control(continue_to_send)) {
+      abort();
+    }
+  }
+}
+
+LIBHAL_CANROUTER_FAST_CODE
+bool can_isotp_receiver::send_flow_control(std::uint8_t p_status)
+{
+  can::message_t message{
+    .id = m_flow_control.id,
+    .length = 8,
+  };
+  message.payload.fill(padding);
+  message.payload[0] = static_cast<hal::byte>(
+    (static_cast<std::uint8_t>(frame_type::flow_control) << 4U) | p_status);
+  message.payload[1] = m_flow_control.block_size;
+  message.payload[2] = m_flow_control.separation_time;
+
+  try {
+    m_bus->send(message);
+  } catch (const hal::exception&) {
+    return false;
+  }
+  return true;
+}
+
+LIBHAL_CANROUTER_FAST_CODE
+void can_isotp_receiver::abort()
+{
+  m_pool->release(m_buffer);
+  m_buffer = {};
+  m_aborted_count++;
+}
+}  // namespace hal
@@ -0,0 +1,97 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libhal-canrouter/can_mailbox.hpp"
+
+namespace hal {
+/**
+ * @brief Construct a mailbox that timestamps messages
+ *
+ * @param p_clock - clock read each time a message is written. Must outlive the
+ * mailbox.
+ */
+can_mailbox::can_mailbox(hal::steady_clock& p_clock)
+  : m_clock(&p_clock)
+{
+}
+
+/**
+ * @brief Replace the mailbox contents with a message
+ *
+ * Must only be called from the writer context. Registering the mailbox as a
+ * route handler, for example with `can_router::add_mailbox()`, makes the
+ * receive handler the writer.
+ *
+ * @param p_message - message to store
+ */
+LIBHAL_CANROUTER_FAST_CODE
+void can_mailbox::operator()(const can::message_t& p_message)
+{
+  auto const timestamp = m_clock ? m_clock->uptime() : 0;
+  auto const sequence = m_sequence.load(std::memory_order_relaxed);
+
+  m_sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  m_message = p_message;
+  m_timestamp = timestamp;
+
+  // Zero is reserved for a mailbox that has never been written
+  auto const next = sequence + 2 == 0 ? 2 : sequence + 2;
+  m_sequence.store(next, std::memory_order_release);
+}
+
+/**
+ * @brief Take a snapshot of the latest message
+ *
+ * @return std::optional<snapshot> - the latest message, or std::nullopt if no
+ * message has been written yet.
+ */
+std::optional<can_mailbox::snapshot> can_mailbox::read() const
+{
+  while (true) {
+    auto const before = m_sequence.load(std::memory_order_acquire);
+    if (before == 0) {
+      return std::nullopt;
+    }
+    if (before & 1U) {
+      continue;
+    }
+
+    snapshot const result{
+      .message = m_message,
+      .timestamp = m_timestamp,
+      .sequence = before / 2,
+    };
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (m_sequence.load(std::memory_order_relaxed) == before) {
+      return result;
+    }
+  }
+}
+
+/**
+ * @brief Get the number of messages written to the mailbox
+ *
+ * Cheaper than read() for checking whether a new message has arrived since the
+ * last snapshot.
+ *
+ * @return std::uint32_t - number of messages written. Wraps on overflow.
+ */
+std::uint32_t can_mailbox::sequence() const
+{
+  return m_sequence.load(std::memory_order_acquire) / 2;
+}
+}  // namespace hal
@@ -0,0 +1,114 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libhal-canrouter/can_message_queue.hpp"
+
+#include <libhal/error.hpp>
+
+#include "ring_position.hpp"
+
+namespace hal {
+/**
+ * @brief Construct a new can message queue
+ *
+ * @param p_storage - storage for queued messages. Must outlive the queue.
+ * @throws hal::argument_out_of_domain - if p_storage is empty
+ */
+can_message_queue::can_message_queue(std::span<can::message_t> p_storage)
+  : m_storage(p_storage)
+{
+  if (m_storage.empty()) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+}
+
+/**
+ * @brief Add a message to the back of the queue
+ *
+ * Must only be called from the producer context.
+ *
+ * @param p_message - message to copy into the queue
+ * @return true - if the message was queued
+ * @return false - if the queue was full and the message was dropped
+ */
+LIBHAL_CANROUTER_FAST_CODE
+bool can_message_queue::push(const can::message_t& p_message)
+{
+  ring_position const ring{ m_storage.size() };
+  auto const write = m_write.load(std::memory_order_relaxed);
+  auto const read = m_read.load(std::memory_order_acquire);
+  auto const queued = ring.distance(write, read);
+
+  if (queued == m_storage.size()) {
+    m_overflow_count.store(
+      m_overflow_count.load(std::memory_order_relaxed) + 1,
+      std::memory_order_relaxed);
+    return false;
+  }
+
+  m_storage[ring.index(write)] = p_message;
+  m_write.store(ring.advance(write), std::memory_order_release);
+
+  if (queued + 1 > m_high_water_mark.load(std::memory_order_relaxed)) {
+    m_high_water_mark.store(queued + 1, std::memory_order_relaxed);
+  }
+
+  return true;
+}
+
+/**
+ * @brief Remove the message at the front of the queue
+ *
+ * Must only be called from the consumer context.
+ *
+ * @return std::optional<can::message_t> - the message, or std::nullopt if the
+ * queue is empty.
+ */
+std::optional<can::message_t> can_message_queue::pop()
+{
+  ring_position const ring{ m_storage.size() };
+  auto const read = m_read.load(std::memory_order_relaxed);
+  auto const write = m_write.load(std::memory_order_acquire);
+
+  if (read == write) {
+    return std::nullopt;
+  }
+
+  can::message_t const message = m_storage[ring.index(read)];
+  m_read.store(ring.advance(read), std::memory_order_release);
+  return message;
+}
+
+std::size_t can_message_queue::size() const
+{
+  return ring_position{ m_storage.size() }.distance(
+    m_write.load(std::memory_order_acquire),
+    m_read.load(std::memory_order_acquire));
+}
+
+std::size_t can_message_queue::capacity() const
+{
+  return m_storage.size();
+}
+
+std::uint32_t can_message_queue::overflow_count() const
+{
+  return m_overflow_count.load(std::memory_order_relaxed);
+}
+
+std::size_t can_message_queue::high_water_mark() const
+{
+  return m_high_water_mark.load(std::memory_order_relaxed);
+}
+}  // namespace hal
@@ -0,0 +1,106 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libhal-canrouter/can_mux.hpp"
+
+#include <libhal/error.hpp>
+
+namespace hal {
+/**
+ * @brief Construct a new mux
+ *
+ * @param p_table - one handler per selector value, `1 << width` elements long.
+ * Must outlive the mux.
+ * @param p_selector - location of the multiplexer field
+ * @throws hal::argument_out_of_domain - if the field does not fit within a
+ * payload byte or p_table does not have `1 << width` elements.
+ */
+can_mux::can_mux(std::span<message_handler> p_table, selector p_selector)
+  : m_table(p_table)
+  , m_selector(p_selector)
+{
+  if (m_selector.width == 0 || m_selector.width > max_selector_width ||
+      m_selector.shift + m_selector.width > max_selector_width ||
+      m_selector.byte >= can::message_t{}.payload.size() ||
+      m_table.size() != (std::size_t{ 1 } << m_selector.width)) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+  m_mask = static_cast<std::uint8_t>(m_table.size() - 1);
+}
+
+/**
+ * @brief Set the handler for one selector value
+ *
+ * @param p_value - selector value
+ * @param p_handler - callback to be executed for messages with that value
+ * @throws hal::argument_out_of_domain - if p_value does not fit the field
+ */
+void can_mux::set(std::uint8_t p_value, message_handler p_handler)
+{
+  if (p_value > m_mask) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+  m_table[p_value] = std::move(p_handler);
+  m_set[p_value / 32] |= std::uint32_t{ 1 } << (p_value % 32);
+}
+
+/**
+ * @brief Remove the handler for one selector value
+ *
+ * @param p_value - selector value
+ * @throws hal::argument_out_of_domain - if p_value does not fit the field
+ */
+void can_mux::clear(std::uint8_t p_value)
+{
+  if (p_value > m_mask) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+  m_set[p_value / 32] &= ~(std::uint32_t{ 1 } << (p_value % 32));
+  m_table[p_value] = {};
+}
+
+/**
+ * @brief Run the handler for a message's selector value
+ *
+ * @param p_message - message received for the mux's ID
+ */
+LIBHAL_CANROUTER_FAST_CODE
+void can_mux::operator()(const can::message_t& p_message)
+{
+  if (p_message.length <= m_selector.byte) {
+    m_unselected_count++;
+    return;
+  }
+
+  std::size_t const value =
+    (p_message.payload[m_selector.byte] >> m_selector.shift) & m_mask;
+  if (not is_set(value)) {
+    m_unselected_count++;
+    return;
+  }
+
+  m_table[value](p_message);
+}
+
+std::uint32_t can_mux::unselected_count() const
+{
+  return m_unselected_count;
+}
+
+LIBHAL_CANROUTER_FAST_CODE
+bool can_mux::is_set(std::size_t p_value) const
+{
+  return (m_set[p_value / 32] >> (p_value % 32)) & 1U;
+}
+}  // namespace hal
@@ -0,0 +1,196 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libhal-canrouter/can_receiver.hpp"
+
+namespace hal {
+/**
+ * @brief Stop waiting
+ *
+ * Only does anything when the coroutine's frame is destroyed while it waits,
+ * for example when its task is cancelled, so the receiver never resumes a
+ * destroyed coroutine.
+ */
+can_receiver::awaiter::~awaiter()
+{
+  if (m_list) {
+    m_list->erase(*this);
+  }
+}
+
+void can_receiver::awaiter::await_suspend(
+  std::coroutine_handle<> p_handle) noexcept
+{
+  auto& receiver = *m_receiver;
+  auto const first = receiver.m_waiters.m_head == nullptr;
+
+  m_handle = p_handle;
+  m_message.reset();
+  receiver.m_waiters.push_back(*this);
+
+  if (receiver.m_timeout) {
+    m_started = receiver.m_wheel->now();
+    // Waits share a length, so the oldest wait has the nearest deadline and
+    // the timeout only follows it. Restarting also clears an expiry left by
+    // earlier waits.
+    if (first) {
+      receiver.m_timeout->restart(m_started);
+    }
+  }
+}
+
+/**
+ * @brief Construct a receiver whose waits time out
+ *
+ * Each wait times out p_length ticks of the wheel after it begins, however
+ * many other waits are in flight. Must be constructed and destroyed from the
+ * context calling the wheel's tick(), which is also the context waits must
+ * begin from.
+ *
+ * @param p_wheel - wheel measuring the timeouts. Must outlive the receiver.
+ * @param p_length - ticks to wait for a message
+ * @throws hal::argument_out_of_domain - if p_length is zero.
+ */
+can_receiver::can_receiver(can_timeout_wheel& p_wheel, std::uint32_t p_length)
+  : m_wheel(&p_wheel)
+  , m_length(p_length)
+{
+  m_timeout.emplace(p_wheel, p_length, [this]() { expire(); });
+}
+
+/**
+ * @brief Resumes every waiting coroutine with std::nullopt
+ *
+ */
+can_receiver::~can_receiver()
+{
+  cancel();
+}
+
+/**
+ * @brief Wait for the next message
+ *
+ * @return awaiter - awaitable producing the message, or std::nullopt if the
+ * wait timed out or was cancelled.
+ */
+can_receiver::awaiter can_receiver::next()
+{
+  return awaiter(*this);
+}
+
+/**
+ * @brief Resume every waiting coroutine with a message
+ *
+ * Called by the router for each message matching the receiver's route.
+ * Coroutines are resumed in the order they began waiting. Coroutines that wait
+ * again while being resumed wait for the following message.
+ *
+ * @param p_message - message received for the route
+ */
+void can_receiver::operator()(const can::message_t& p_message)
+{
+  resume_all(p_message);
+}
+
+/**
+ * @brief Resume every waiting coroutine with std::nullopt
+ *
+ */
+void can_receiver::cancel()
+{
+  resume_all(std::nullopt);
+}
+
+/**
+ * @return true - if at least one coroutine is waiting
+ */
+bool can_receiver::waiting() const
+{
+  return m_waiters.m_head != nullptr;
+}
+
+void can_receiver::waiter_list::push_back(awaiter& p_waiter)
+{
+  p_waiter.m_list = this;
+  p_waiter.m_prev = m_tail;
+  p_waiter.m_next = nullptr;
+  if (m_tail) {
+    m_tail->m_next = &p_waiter;
+  } else {
+    m_head = &p_waiter;
+  }
+  m_tail = &p_waiter;
+}
+
+void can_receiver::waiter_list::erase(awaiter& p_waiter)
+{
+  if (p_waiter.m_prev) {
+    p_waiter.m_prev->m_next = p_waiter.m_next;
+  } else {
+    m_head = p_waiter.m_next;
+  }
+  if (p_waiter.m_next) {
+    p_waiter.m_next->m_prev = p_waiter.m_prev;
+  } else {
+    m_tail = p_waiter.m_prev;
+  }
+  p_waiter.m_list = nullptr;
+}
+
+can_receiver::awaiter* can_receiver::waiter_list::pop_front()
+{
+  auto* const waiter = m_head;
+  if (waiter) {
+    erase(*waiter);
+  }
+  return waiter;
+}
+
+void can_receiver::expire()
+{
+  auto const now = m_wheel->now();
+
+  waiter_list expired;
+  while (m_waiters.m_head && now - m_waiters.m_head->m_started >= m_length) {
+    expired.push_back(*m_waiters.pop_front());
+  }
+
+  // Waits that are left, or that ended early, still need their own deadline
+  if (m_waiters.m_head) {
+    m_timeout->restart(m_waiters.m_head->m_started);
+  }
+  resume(expired, std::nullopt);
+}
+
+void can_receiver::resume_all(const std::optional<can::message_t>& p_message)
+{
+  // Moved out first, so that coroutines waiting again join a new list
+  waiter_list waiters;
+  while (auto* waiter = m_waiters.pop_front()) {
+    waiters.push_back(*waiter);
+  }
+  resume(waiters, p_message);
+}
+
+void can_receiver::resume(waiter_list& p_waiters,
+                          const std::optional<can::message_t>& p_message)
+{
+  // Popped one at a time, since resuming a coroutine may destroy the frames
+  // of the waits after it, which then unlink themselves from this list
+  while (auto* waiter = p_waiters.pop_front()) {
+    waiter->m_message = p_message;
+    waiter->m_handle.resume();
+  }
+}
+}  // namespace hal
@@ -0,0 +1,311 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libhal-canrouter/can_replay.hpp"
+
+#include <charconv>
+
+#include <libhal/error.hpp>
+
+namespace hal {
+namespace {
+constexpr std::size_t max_id_digits = 8;
+constexpr std::size_t fraction_digits = 6;
+constexpr std::uint64_t microseconds_per_second = 1'000'000;
+
+[[nodiscard]] bool is_space(char p_character)
+{
+  return p_character == ' ' || p_character == '\t' || p_character == '\r' ||
+         p_character == '\n';
+}
+
+[[nodiscard]] std::string_view trim(std::string_view p_text)
+{
+  while (not p_text.empty() && is_space(p_text.front())) {
+    p_text.remove_prefix(1);
+  }
+  while (not p_text.empty() && is_space(p_text.back())) {
+    p_text.remove_suffix(1);
+  }
+  return p_text;
+}
+
+/// Removes and returns the text up to the next whitespace
+[[nodiscard]] std::string_view next_token(std::string_view& p_text)
+{
+  p_text = trim(p_text);
+  std::size_t length = 0;
+  while (length < p_text.size() && not is_space(p_text[length])) {
+    length++;
+  }
+  auto const token = p_text.substr(0, length);
+  p_text.remove_prefix(length);
+  return token;
+}
+
+template<class T>
+[[nodiscard]] std::optional<T> parse_number(std::string_view p_text,
+                                            int p_base)
+{
+  T value{};
+  auto const* const end = p_text.data() + p_text.size();
+  auto const [position, error] =
+    std::from_chars(p_text.data(), end, value, p_base);
+  if (p_text.empty() || error != std::errc{} || position != end) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+/// Parses `(seconds.fraction)` into microseconds
+[[nodiscard]] std::optional<std::uint64_t> parse_timestamp(
+  std::string_view p_text)
+{
+  if (p_text.size() < 2 || p_text.front() != '(' || p_text.back() != ')') {
+    return std::nullopt;
+  }
+  p_text = p_text.substr(1, p_text.size() - 2);
+
+  auto const point = p_text.find('.');
+  auto const fraction =
+    point == std::string_view::npos ? std::string_view{} : p_text.substr(point);
+  auto const seconds = parse_number<std::uint64_t>(p_text.substr(0, point), 10);
+  if (not seconds) {
+    return std::nullopt;
+  }
+
+  std::uint64_t microseconds = 0;
+  if (not fraction.empty()) {
+    auto const digits = fraction.substr(1, fraction_digits);
+    auto const value = parse_number<std::uint64_t>(digits, 10);
+    if (not value) {
+      return std::nullopt;
+    }
+    microseconds = *value;
+    for (auto i = digits.size(); i < fraction_digits; i++) {
+      microseconds *= 10;
+    }
+  }
+
+  return (*seconds * microseconds_per_second) + microseconds;
+}
+
+/// Parses the number at the end of an interface name, such as `can1`
+[[nodiscard]] std::optional<std::uint8_t> parse_bus(std::string_view p_text)
+{
+  auto const digits = p_text.find_last_not_of("0123456789") + 1;
+  if (digits == p_text.size()) {
+    return std::uint8_t{ 0 };
+  }
+  return parse_number<std::uint8_t>(p_text.substr(digits), 10);
+}
+
+/// Parses `ID#DATA` or `ID#R` into p_record
+[[nodiscard]] bool parse_frame(std::string_view p_text,
+                               can_capture::record& p_record)
+{
+  auto const separator = p_text.find('#');
+  if (separator == std::string_view::npos || separator > max_id_digits) {
+    return false;
+  }
+  auto const id = parse_number<hal::can::id_t>(p_text.substr(0, separator), 16);
+  if (not id) {
+    return false;
+  }
+  p_record.id = *id;
+
+  auto data = p_text.substr(separator + 1);
+  if (not data.empty() && data.front() == 'R') {
+    p_record.is_remote_request = true;
+    if (data.size() == 1) {
+      return true;
+    }
+    auto const length = parse_number<std::uint8_t>(data.substr(1), 10);
+    if (not length || *length > p_record.payload.size()) {
+      return false;
+    }
+    p_record.length = *length;
+    return true;
+  }
+
+  while (not data.empty()) {
+    if (data.front() == '.') {
+      data.remove_prefix(1);
+      continue;
+    }
+    if (data.size() < 2 || p_record.length == p_record.payload.size()) {
+      return false;
+    }
+    auto const value = parse_number<hal::byte>(data.substr(0, 2), 16);
+    if (not value) {
+      return false;
+    }
+    p_record.payload[p_record.length++] = *value;
+    data.remove_prefix(2);
+  }
+  return true;
+}
+}  // namespace
+
+/**
+ * @brief Parse one line of a candump log
+ *
+ * Accepts the log format written by `candump -L` and read by `canplayer`, for
+ * example `(1436509052.249713) can0 123#DEADBEEF`. Data bytes may be separated
+ * by dots, remote requests are written as `123#R` with an optional length
+ * digit, and the number at the end of the interface name becomes the bus.
+ * Timestamps are converted to microseconds and truncated to 32 bits.
+ *
+ * @param p_line - line to parse, with or without its line ending
+ * @return std::optional<can_capture::record> - the message, or std::nullopt if
+ * the line is not a classic CAN frame in the log format.
+ */
+std::optional<can_capture::record> parse_candump(std::string_view p_line)
+{
+  auto const timestamp = parse_timestamp(next_token(p_line));
+  auto const bus = parse_bus(next_token(p_line));
+  auto const frame = next_token(p_line);
+  if (not timestamp || not bus || not trim(p_line).empty()) {
+    return std::nullopt;
+  }
+
+  can_capture::record record{
+    .timestamp = static_cast<std::uint32_t>(*timestamp),
+    .bus = *bus,
+  };
+  if (not parse_frame(frame, record)) {
+    return std::nullopt;
+  }
+  return record;
+}
+
+/**
+ * @brief Construct a replay that delivers records as fast as possible
+ *
+ * @param p_router - router to deliver records to. Must outlive the replay.
+ */
+can_replay::can_replay(can_router& p_router)
+  : m_router(&p_router)
+{
+}
+
+/**
+ * @brief Construct a replay paced to the records' own timing
+ *
+ * @param p_router - router to deliver records to. Must outlive the replay.
+ * @param p_clock - clock to pace the replay with. Must outlive the replay.
+ * @param p_speed - how many times faster than recorded to replay, 1.0 for the
+ * original speed
+ * @throws hal::argument_out_of_domain - if p_speed is not positive.
+ */
+can_replay::can_replay(can_router& p_router,
+                       hal::steady_clock& p_clock,
+                       float p_speed)
+  : m_router(&p_router)
+  , m_clock(&p_clock)
+  , m_speed(p_speed)
+{
+  if (not(m_speed > 0.0f)) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+}
+
+/**
+ * @brief Replay a capture
+ *
+ * @param p_records - records to replay, oldest first
+ * @param p_frequency - frequency of the records' timestamps, such as
+ * can_capture::frequency() of the capture that recorded them
+ * @return std::size_t - number of records delivered
+ */
+std::size_t can_replay::play(std::span<const can_capture::record> p_records,
+                             hal::hertz p_frequency)
+{
+  restart(p_frequency);
+  std::size_t delivered = 0;
+  for (auto const& record : p_records) {
+    if (deliver(record)) {
+      delivered++;
+    }
+  }
+  return delivered;
+}
+
+/**
+ * @brief Replay a candump log
+ *
+ * Lines that parse_candump() rejects are skipped.
+ *
+ * @param p_log - contents of the log, one frame per line
+ * @return std::size_t - number of frames delivered
+ */
+std::size_t can_replay::play(std::string_view p_log)
+{
+  restart(candump_frequency);
+  std::size_t delivered = 0;
+  while (not p_log.empty()) {
+    auto const end = p_log.find('\n');
+    auto const record = parse_candump(p_log.substr(0, end));
+    if (record && deliver(*record)) {
+      delivered++;
+    }
+    p_log.remove_prefix(end == std::string_view::npos ? p_log.size() : end + 1);
+  }
+  return delivered;
+}
+
+std::uint32_t can_replay::skipped_count() const
+{
+  return m_skipped_count;
+}
+
+void can_replay::restart(hal::hertz p_frequency)
+{
+  m_ticks_per_record_tick = 0.0;
+  if (m_clock && p_frequency > 0.0f) {
+    m_ticks_per_record_tick =
+      static_cast<double>(m_clock->frequency()) /
+      (static_cast<double>(p_frequency) * static_cast<double>(m_speed));
+  }
+  m_started = false;
+}
+
+bool can_replay::deliver(const can_capture::record& p_record)
+{
+  if (p_record.bus >= m_router->bus_count()) {
+    m_skipped_count++;
+    return false;
+  }
+
+  if (m_ticks_per_record_tick > 0.0 && not m_started) {
+    m_start = m_clock->uptime();
+    m_elapsed = 0;
+    m_started = true;
+  } else if (m_ticks_per_record_tick > 0.0) {
+    // Unsigned subtraction keeps the spacing across timestamp wrap around
+    m_elapsed += static_cast<std::uint32_t>(p_record.timestamp - m_previous);
+    auto const deadline =
+      m_start + static_cast<std::uint64_t>(static_cast<double>(m_elapsed) *
+                                           m_ticks_per_record_tick);
+    while (m_clock->uptime() < deadline) {
+      continue;
+    }
+  }
+  m_previous = p_record.timestamp;
+
+  auto const message = p_record.message();
+  m_router->dispatch(std::span(&message, 1), p_record.bus);
+  return true;
+}
+}  // namespace hal
@@ -0,0 +1,237 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libhal-canrouter/can_route_policy.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace hal {
+/**
+ * @brief Limit the number of handler runs within a time window
+ *
+ * Windows are consecutive: one starts with the first admitted message after
+ * the previous window has ended.
+ *
+ * @param p_clock - clock to measure windows with, or nullptr to remove the
+ * limit. Must outlive the policy or be replaced before it is destroyed.
+ * @param p_window - length of each window
+ * @param p_max_runs - most handler runs within one window
+ */
+void can_route_policy::limit_rate(hal::steady_clock* p_clock,
+                                  hal::time_duration p_window,
+                                  std::uint32_t p_max_runs)
+{
+  m_clock = p_clock;
+  m_max_runs = p_max_runs;
+  m_window_runs = 0;
+  m_window = 0;
+
+  if (m_clock == nullptr) {
+    return;
+  }
+
+  // Converted to ticks once, so admit() only compares integers
+  auto const seconds = std::chrono::duration<double>(p_window).count();
+  m_window =
+    static_cast<std::uint64_t>(std::ceil(seconds * m_clock->frequency()));
+}
+
+/**
+ * @brief Only admit every Nth message
+ *
+ * @param p_every - admit one message out of every p_every, starting with the
+ * first. Zero or one admits every message.
+ */
+void can_route_policy::decimate(std::uint32_t p_every)
+{
+  m_every = p_every;
+  m_decimation_count = 0;
+}
+
+/**
+ * @brief Only admit messages whose contents differ from the previous one
+ *
+ * Compares the length, remote request flag and payload against the last
+ * admitted message. Only the first `length` bytes of the payload are compared,
+ * as one 64-bit word. The first message is always admitted, and so is every
+ * CAN FD frame with more than 8 bytes of payload.
+ *
+ * @param p_enabled - whether repeated messages are suppressed
+ * @param p_refresh_every - admit a repeated message anyway when it is the
+ * p_refresh_every-th message since the last admitted one, so the handler runs
+ * at least that often for periodic messages. Zero never refreshes.
+ */
+void can_route_policy::only_on_change(bool p_enabled,
+                                      std::uint32_t p_refresh_every)
+{
+  m_only_on_change = p_enabled;
+  m_refresh_every = p_refresh_every;
+  m_unchanged_run = 0;
+  m_has_last = false;
+}
+
+/**
+ * @brief Decide whether a message may run the route's handler
+ *
+ * Called by the router before every handler run. Must only be called from one
+ * context at a time.
+ *
+ * @param p_message - message received for the route
+ * @return true - if the handler should run for this message
+ */
+LIBHAL_CANROUTER_FAST_CODE
+bool can_route_policy::admit(const can::message_t& p_message)
+{
+  auto const payload = m_only_on_change ? payload_word(p_message) : 0;
+  return admit(p_message.length, p_message.is_remote_request, payload, true);
+}
+
+/**
+ * @brief Decide whether a frame may run the route's handler
+ *
+ * Called by the router before every handler run for frames dispatched as a
+ * can_frame, including CAN FD frames. Must only be called from one context at
+ * a time.
+ *
+ * @param p_frame - frame received for the route
+ * @return true - if the handler should run for this frame
+ */
+LIBHAL_CANROUTER_FAST_CODE
+bool can_route_policy::admit(const can_frame& p_frame)
+{
+  // Longer payloads do not fit the word compared by change detection
+  bool const comparable = p_frame.payload.size() <= sizeof(std::uint64_t);
+  auto const payload =
+    m_only_on_change && comparable ? payload_word(p_frame.payload) : 0;
+  return admit(
+    p_frame.payload.size(), p_frame.is_remote_request, payload, comparable);
+}
+
+/**
+ * @return suppressed_counts - number of messages suppressed by each policy.
+ * Wraps on overflow.
+ */
+can_route_policy::suppressed_counts can_route_policy::suppressed() const
+{
+  return m_suppressed;
+}
+
+/**
+ * @brief Clear the suppressed message counts
+ *
+ */
+void can_route_policy::reset_suppressed()
+{
+  m_suppressed = {};
+}
+
+LIBHAL_CANROUTER_FAST_CODE
+std::uint64_t can_route_policy::payload_word(const can::message_t& p_message)
+{
+  std::uint64_t word = 0;
+  static_assert(sizeof(word) == sizeof(p_message.payload));
+  std::memcpy(&word, p_message.payload.data(), sizeof(word));
+
+  // Bytes past the length are left over from earlier messages and ignored
+  auto const length =
+    std::min<std::size_t>(p_message.length, p_message.payload.size());
+  if (length == sizeof(word)) {
+    return word;
+  }
+  auto const bits = length * 8;
+  if constexpr (std::endian::native == std::endian::little) {
+    return word & ((std::uint64_t{ 1 } << bits) - 1);
+  } else {
+    return length == 0 ? 0 : word & ~(~std::uint64_t{ 0 } >> bits);
+  }
+}
+
+LIBHAL_CANROUTER_FAST_CODE
+std::uint64_t can_route_policy::payload_word(
+  std::span<const hal::byte> p_payload)
+{
+  // A view may end at its last byte, so only its bytes are read
+  std::uint64_t word = 0;
+  if (not p_payload.empty()) {
+    std::memcpy(&word, p_payload.data(), p_payload.size());
+  }
+  return word;
+}
+
+LIBHAL_CANROUTER_FAST_CODE
+bool can_route_policy::admit(std::size_t p_length,
+                             bool p_remote_request,
+                             std::uint64_t p_payload,
+                             bool p_comparable)
+{
+  if (m_every > 1) {
+    auto const position = m_decimation_count;
+    m_decimation_count = position + 1 == m_every ? 0 : position + 1;
+    if (position != 0) {
+      m_suppressed.decimated++;
+      return false;
+    }
+  }
+
+  if (m_only_on_change && p_comparable) {
+    bool const refresh =
+      m_refresh_every != 0 && m_unchanged_run + 1 >= m_refresh_every;
+    if (not refresh && repeats_last(p_length, p_remote_request, p_payload)) {
+      m_unchanged_run++;
+      m_suppressed.unchanged++;
+      return false;
+    }
+  }
+
+  if (m_clock && m_max_runs != 0) {
+    auto const now = m_clock->uptime();
+    if (m_window_runs == 0 || now - m_window_start >= m_window) {
+      m_window_start = now;
+      m_window_runs = 0;
+    }
+    if (m_window_runs == m_max_runs) {
+      m_suppressed.rate_limited++;
+      return false;
+    }
+    m_window_runs++;
+  }
+
+  // Only admitted messages are remembered, so that a change suppressed by the
+  // rate limit still runs the handler once the limit allows it. A payload that
+  // could not be compared is never repeated by the next one.
+  if (m_only_on_change) {
+    m_last_payload = p_payload;
+    m_unchanged_run = 0;
+    m_last_length = static_cast<std::uint8_t>(p_length);
+    m_last_remote_request = p_remote_request;
+    m_has_last = p_comparable;
+  }
+
+  return true;
+}
+
+LIBHAL_CANROUTER_FAST_CODE
+bool can_route_policy::repeats_last(std::size_t p_length,
+                                    bool p_remote_request,
+                                    std::uint64_t p_payload) const
+{
+  return m_has_last && p_length == m_last_length &&
+         p_remote_request == m_last_remote_request &&
+         p_payload == m_last_payload;
+}
+}  // namespace hal
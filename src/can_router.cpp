@@ -14,28 +14,190 @@
 
 #include "libhal-canrouter/can_router.hpp"
 
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
 #include <libhal-util/can.hpp>
 #include <libhal-util/comparison.hpp>
+#include <libhal/error.hpp>
 
 namespace hal {
+template<class Route>
+can_router::basic_route_item<Route>::basic_route_item(
+  can_router* p_router,
+  typename static_list<Route>::item&& p_item)
+  : m_item(std::move(p_item))
+  , m_router(p_router)
+{
+  if (m_router) {
+    m_router->index_insert(*this);
+  }
+}
+
+template<class Route>
+can_router::basic_route_item<Route>::basic_route_item(
+  basic_route_item&& p_other) noexcept
+  : m_item(std::move(p_other.m_item))
+  , m_router(p_other.m_router)
+{
+  if (m_router) {
+    m_router->index_relocate(p_other, *this);
+  }
+  p_other.m_router = nullptr;
+}
+
+template<class Route>
+can_router::basic_route_item<Route>&
+can_router::basic_route_item<Route>::operator=(
+  basic_route_item&& p_other) noexcept
+{
+  if (m_router) {
+    m_router->index_erase(*this);
+  }
+  m_item = std::move(p_other.m_item);
+  m_router = p_other.m_router;
+  if (m_router) {
+    m_router->index_relocate(p_other, *this);
+  }
+  p_other.m_router = nullptr;
+  return *this;
+}
+
+template<class Route>
+can_router::basic_route_item<Route>::~basic_route_item()
+{
+  if (m_router) {
+    m_router->index_erase(*this);
+  }
+}
+
+template<class Route>
+Route& can_router::basic_route_item<Route>::get()
+{
+  return m_item.get();
+}
+
 /**
  * @brief Construct a new can message router
  *
  * @param p_can - can peripheral to route messages for
  */
 can_router::can_router(hal::can& p_can)
-  : m_can(&p_can)
 {
-  m_can->on_receive(std::ref((*this)));
+  attach(p_can);
+}
+
+/**
+ * @brief Construct a new can message router with an indexed lookup
+ *
+ * Every route added to this router is inserted into `p_index_storage`, sorted
+ * by ID. The storage must outlive the router and its size determines the
+ * maximum number of routes that can be registered.
+ *
+ * @param p_can - can peripheral to route messages for
+ * @param p_index_storage - storage for the sorted route index
+ */
+can_router::can_router(hal::can& p_can, std::span<index_entry> p_index_storage)
+  : m_index(p_index_storage)
+{
+  attach(p_can);
+}
+
+/**
+ * @brief Construct a new can message router with an indexed lookup and a
+ * direct lookup table for standard IDs
+ *
+ * Messages with standard IDs are located with a single access to
+ * `p_standard_table`. Extended IDs are located with a binary search over the
+ * extended portion of the index. The table costs 4kB of RAM and must outlive
+ * the router.
+ *
+ * @param p_can - can peripheral to route messages for
+ * @param p_index_storage - storage for the sorted route index
+ * @param p_standard_table - direct lookup table for standard IDs
+ * @throws hal::argument_out_of_domain - if p_index_storage has more entries
+ * than p_standard_table can refer to.
+ */
+can_router::can_router(hal::can& p_can,
+                       std::span<index_entry> p_index_storage,
+                       standard_id_table& p_standard_table)
+  : m_index(p_index_storage)
+  , m_standard_table(&p_standard_table)
+{
+  if (p_index_storage.size() >= UINT16_MAX) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+  m_standard_table->fill(0);
+  attach(p_can);
 }
 
 can_router& can_router::operator=(can_router&& p_other) noexcept
 {
+  release_route_items();
+
   m_handlers = std::move(p_other.m_handlers);
-  m_can = p_other.m_can;
-  m_can->on_receive(std::ref(*this));
+  m_thin_handlers = std::move(p_other.m_thin_handlers);
+  m_index = p_other.m_index;
+  m_index_size = p_other.m_index_size;
+  m_wildcard_size = p_other.m_wildcard_size;
+  m_standard_size = p_other.m_standard_size;
+  m_spare_index = p_other.m_spare_index;
+  m_live_updates.store(p_other.m_live_updates.load());
+  m_views = p_other.m_views;
+  m_view.store(p_other.m_view.load() == &p_other.m_views[0] ? &m_views[0]
+                                                             : &m_views[1]);
+  m_standard_table = p_other.m_standard_table;
+  m_hot_routes = p_other.m_hot_routes;
+  m_id_filter = p_other.m_id_filter;
+  m_unrouted = std::move(p_other.m_unrouted);
+  m_unrouted_count = p_other.m_unrouted_count;
+  m_has_unrouted = p_other.m_has_unrouted;
+  m_deferred_queues = p_other.m_deferred_queues;
+  m_deferred_contexts = p_other.m_deferred_contexts;
+  m_buses = p_other.m_buses;
+  m_bus_count = p_other.m_bus_count;
+  m_capture = p_other.m_capture;
+#if LIBHAL_CANROUTER_INSTRUMENTATION
+  m_received_count = p_other.m_received_count;
+  m_clock = p_other.m_clock;
+#endif
+  for (std::uint8_t bus = 0; bus < m_bus_count; bus++) {
+    listen(bus);
+  }
+
+  // Route items refer back to the router that owns their index entries
+  for (auto& entry : std::span(m_index).first(m_index_size)) {
+    link_owner(entry, this);
+  }
+  for (auto& entry : wildcard_index()) {
+    link_owner(entry, this);
+  }
 
-  p_other.m_can = nullptr;
+  p_other.m_index = {};
+  p_other.m_index_size = 0;
+  p_other.m_wildcard_size = 0;
+  p_other.m_standard_size = 0;
+  p_other.m_spare_index = {};
+  p_other.m_live_updates.store(false);
+  p_other.m_views = {};
+  p_other.m_view.store(&p_other.m_views[0]);
+  p_other.m_standard_table = nullptr;
+  p_other.m_hot_routes = {};
+  p_other.m_id_filter = nullptr;
+  p_other.m_has_unrouted = false;
+  p_other.m_deferred_queues = {};
+  p_other.m_deferred_contexts = {};
+  p_other.m_buses = {};
+  p_other.m_bus_count = 0;
+  p_other.m_capture = nullptr;
+#if LIBHAL_CANROUTER_INSTRUMENTATION
+  p_other.m_clock = nullptr;
+#endif
   return *this;
 }
 
@@ -46,10 +208,12 @@ can_router::can_router(can_router&& p_other) noexcept
 
 can_router::~can_router()
 {
-  if (m_can) {
+  release_route_items();
+
+  for (auto* can : std::span(m_buses).first(m_bus_count)) {
     // Assume that if this succeeded in the create factory function, that it
     // will work this time
-    m_can->on_receive(noop);
+    can->on_receive(noop);
   }
 }
 
@@ -63,7 +227,93 @@ can_router::~can_router()
  */
 hal::can& can_router::bus()
 {
-  return *m_can;
+  return *m_buses[0];
+}
+
+/**
+ * @brief Get a reference to one of the buses the router receives from
+ *
+ * @param p_bus - bus number, as returned by attach(). The bus passed to the
+ * constructor is bus 0.
+ * @return can& reference to the can peripheral driver
+ * @throws hal::argument_out_of_domain - if no bus has that number
+ */
+hal::can& can_router::bus(std::uint8_t p_bus)
+{
+  if (p_bus >= m_bus_count) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+  return *m_buses[p_bus];
+}
+
+/**
+ * @return std::uint8_t - number of buses the router receives from
+ */
+std::uint8_t can_router::bus_count() const
+{
+  return m_bus_count;
+}
+
+/**
+ * @brief Receive messages from another bus
+ *
+ * Messages from every bus are resolved through the same routes and index.
+ * Routes with `bus` set to the returned number only receive messages from this
+ * bus, while routes with `any_bus` receive them from all of them.
+ *
+ * The receive handlers of every bus share the router's lookup state, so they
+ * must not preempt one another: give the buses' receive interrupts the same
+ * priority, or call dispatch() for each bus from one context.
+ *
+ * @param p_can - can peripheral to also route messages for. Must outlive the
+ * router.
+ * @return std::uint8_t - number of the bus within this router
+ * @throws hal::resource_unavailable_try_again - if the router already receives
+ * from max_buses buses.
+ */
+std::uint8_t can_router::attach(hal::can& p_can)
+{
+  if (m_bus_count == max_buses) {
+    hal::safe_throw(hal::resource_unavailable_try_again(this));
+  }
+
+  auto const bus = m_bus_count;
+  m_buses[bus] = &p_can;
+  listen(bus);
+  m_bus_count++;
+  return bus;
+}
+
+/**
+ * @brief Get the bus that the message being handled was received on
+ *
+ * Only meaningful while a route handler is running, whether from the receive
+ * handler or from poll().
+ *
+ * @return std::uint8_t - number of the bus, as returned by attach()
+ */
+std::uint8_t can_router::source_bus() const
+{
+  return m_source_bus;
+}
+
+/**
+ * @brief Get the bus of the message being handled by one execution context
+ *
+ * Meant for the handlers of contexts other than 0, which poll_context() runs
+ * alongside the receive handler and so cannot share source_bus(). Only
+ * meaningful while a route handler of that context is running from
+ * poll_context().
+ *
+ * @param p_context - execution context running the handler
+ * @return std::uint8_t - number of the bus, as returned by attach()
+ */
+std::uint8_t can_router::source_bus(std::uint8_t p_context) const
+{
+  if (p_context == 0 || p_context >= max_contexts) {
+    return m_source_bus;
+  }
+  return m_context_buses[p_context];
 }
 
 /**
@@ -75,10 +325,9 @@ hal::can& can_router::bus()
  * @return auto - route item from the linked list that must be stored stored
  * in a variable
  */
-static_list<can_router::route>::item can_router::add_message_callback(
-  hal::can::id_t p_id)
+can_router::route_item can_router::add_message_callback(hal::can::id_t p_id)
 {
-  return m_handlers.push_back(route{
+  return add_route(route{
     .id = p_id,
   });
 }
@@ -88,19 +337,208 @@ static_list<can_router::route>::item can_router::add_message_callback(
  *
  * @param p_id - Associated ID of messages to be stored.
  * @param p_handler - callback to be executed when a p_id message is received.
+ * @param p_dispatch - context the handler runs in while dispatch is deferred
  * @return auto - route item from the linked list that must be stored stored
  * in a variable
  */
-static_list<can_router::route>::item can_router::add_message_callback(
+can_router::route_item can_router::add_message_callback(
   hal::can::id_t p_id,
-  message_handler p_handler)
+  message_handler p_handler,
+  dispatch_mode p_dispatch)
 {
-  return m_handlers.push_back(route{
+  return add_route(route{
     .id = p_id,
     .handler = std::move(p_handler),
+    .dispatch = p_dispatch,
+  });
+}
+
+/**
+ * @brief Set a callback for messages whose masked ID matches a value
+ *
+ * In an indexed router, mask routes are only searched after the exact ID
+ * routes and are searched linearly.
+ *
+ * @param p_match - value and mask that the message ID must match
+ * @param p_handler - callback to be executed when a matching message is
+ * received.
+ * @param p_dispatch - context the handler runs in while dispatch is deferred
+ * @return route_item - route item from the linked list that must be stored
+ * in a variable
+ * @throws hal::resource_unavailable_try_again - if the router is indexed and
+ * the index storage is full.
+ */
+can_router::route_item can_router::add_message_callback(
+  id_mask p_match,
+  message_handler p_handler,
+  dispatch_mode p_dispatch)
+{
+  return add_route(route{
+    .id = p_match.value & p_match.mask,
+    .handler = std::move(p_handler),
+    .mask = p_match.mask,
+    .dispatch = p_dispatch,
+  });
+}
+
+/**
+ * @brief Set a callback for messages with an ID within a range
+ *
+ * In an indexed router, range routes are only searched after the exact ID
+ * routes and are searched linearly.
+ *
+ * @param p_match - first and last ID of the range
+ * @param p_handler - callback to be executed when a matching message is
+ * received.
+ * @param p_dispatch - context the handler runs in while dispatch is deferred
+ * @return route_item - route item from the linked list that must be stored
+ * in a variable
+ * @throws hal::argument_out_of_domain - if the range's last ID is less than
+ * its first ID.
+ * @throws hal::resource_unavailable_try_again - if the router is indexed and
+ * the index storage is full.
+ */
+can_router::route_item can_router::add_message_callback(
+  id_range p_match,
+  message_handler p_handler,
+  dispatch_mode p_dispatch)
+{
+  if (p_match.last < p_match.first) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+
+  return add_route(route{
+    .id = p_match.first,
+    .handler = std::move(p_handler),
+    .range = p_match.last - p_match.first,
+    .dispatch = p_dispatch,
+  });
+}
+
+/**
+ * @brief Store the latest message with an ID in a mailbox
+ *
+ * The route always runs from the receive handler, even while dispatch is
+ * deferred, so the mailbox is written as soon as the message arrives and
+ * readers take snapshots from any lower priority context.
+ *
+ * @param p_id - Associated ID of messages to be stored
+ * @param p_mailbox - mailbox to write. Must outlive the route.
+ * @return route_item - route item from the linked list that must be stored in
+ * a variable
+ * @throws hal::resource_unavailable_try_again - if the router is indexed and
+ * the index storage is full.
+ */
+can_router::route_item can_router::add_mailbox(hal::can::id_t p_id,
+                                               can_mailbox& p_mailbox)
+{
+  return add_message_callback(
+    p_id, std::ref(p_mailbox), dispatch_mode::immediate);
+}
+
+/**
+ * @brief Forward messages with a specific ID to another bus
+ *
+ * The route always runs from the receive handler, even while dispatch is
+ * deferred. Forwarding many IDs costs one route each, found by the same lookup
+ * as every other route, rather than one user callback each.
+ *
+ * @param p_id - Associated ID of messages to be forwarded
+ * @param p_forwarder - forwarder sending to the destination bus. Must outlive
+ * the route.
+ * @param p_source_bus - bus to forward messages from, or any_bus. A forwarder
+ * sending on one of this router's buses should not forward messages received
+ * on that same bus.
+ * @return route_item - route item from the linked list that must be stored in
+ * a variable
+ * @throws hal::argument_out_of_domain - if p_source_bus is neither any_bus nor
+ * less than max_buses.
+ * @throws hal::resource_unavailable_try_again - if the router is indexed and
+ * the index storage is full.
+ */
+can_router::route_item can_router::add_forward(hal::can::id_t p_id,
+                                               can_forwarder& p_forwarder,
+                                               std::uint8_t p_source_bus)
+{
+  return add_route(route{
+    .id = p_id,
+    .handler = std::ref(p_forwarder),
+    .dispatch = dispatch_mode::immediate,
+    .bus = p_source_bus,
+  });
+}
+
+/**
+ * @brief Forward messages whose masked ID matches a value to another bus
+ *
+ * @param p_match - value and mask that the message ID must match
+ * @param p_forwarder - forwarder sending to the destination bus. Must outlive
+ * the route.
+ * @param p_source_bus - bus to forward messages from, or any_bus
+ * @return route_item - route item from the linked list that must be stored in
+ * a variable
+ * @throws hal::argument_out_of_domain - if p_source_bus is neither any_bus nor
+ * less than max_buses.
+ * @throws hal::resource_unavailable_try_again - if the router is indexed and
+ * the index storage is full.
+ */
+can_router::route_item can_router::add_forward(id_mask p_match,
+                                               can_forwarder& p_forwarder,
+                                               std::uint8_t p_source_bus)
+{
+  return add_route(route{
+    .id = p_match.value & p_match.mask,
+    .handler = std::ref(p_forwarder),
+    .mask = p_match.mask,
+    .dispatch = dispatch_mode::immediate,
+    .bus = p_source_bus,
   });
 }
 
+/**
+ * @brief Reassemble ISO-TP messages received with a specific ID
+ *
+ * The route always runs from the receive handler, even while dispatch is
+ * deferred, so that flow control frames are answered without waiting for
+ * poll().
+ *
+ * @param p_id - ID the transmitter sends its frames with
+ * @param p_receiver - receiver reassembling the messages. Must outlive the
+ * route.
+ * @return route_item - route item from the linked list that must be stored in
+ * a variable
+ * @throws hal::resource_unavailable_try_again - if the router is indexed and
+ * the index storage is full.
+ */
+can_router::route_item can_router::add_isotp(hal::can::id_t p_id,
+                                             can_isotp_receiver& p_receiver)
+{
+  return add_message_callback(
+    p_id, std::ref(p_receiver), dispatch_mode::immediate);
+}
+
+/**
+ * @brief Supervise the reception of messages with a specific ID
+ *
+ * The route always runs from the receive handler, even while dispatch is
+ * deferred, so messages waiting in the queue still count as received. It may
+ * share its ID with the routes that consume the messages.
+ *
+ * @param p_id - ID of the supervised messages
+ * @param p_timeout - timeout restarted by each message. Must outlive the
+ * route.
+ * @return route_item - route item from the linked list that must be stored in
+ * a variable
+ * @throws hal::resource_unavailable_try_again - if the router is indexed and
+ * the index storage is full.
+ */
+can_router::route_item can_router::add_timeout(hal::can::id_t p_id,
+                                               can_timeout& p_timeout)
+{
+  return add_message_callback(
+    p_id, std::ref(p_timeout), dispatch_mode::immediate);
+}
+
 /**
  * @brief Get the list of handlers
  *
@@ -115,20 +553,1420 @@ const static_list<can_router::route>& can_router::handlers()
 }
 
 /**
- * @brief Message routing interrupt service handler
+ * @brief Get the list of thin route handlers
  *
- * Searches the static list and finds the first ID associated with the message
- * and run's that route's callback.
+ * The counterpart of handlers() for routes added with add_thin_route().
  *
- * @param p_message - message received from the bus
+ * @return const auto& map of all of the thin route handlers.
  */
-void can_router::operator()(const can::message_t& p_message)
+const static_list<can_router::thin_route>& can_router::thin_handlers()
 {
-  for (auto& list_handler : m_handlers) {
-    if (p_message.id == list_handler.id) {
-      list_handler.handler(p_message);
+  return m_thin_handlers;
+}
+
+/**
+ * @brief Get the sorted route index
+ *
+ * Meant for testing purposes. The span is empty if this router was not
+ * constructed with index storage.
+ *
+ * @return std::span<const index_entry> - active portion of the index
+ */
+std::span<const can_router::index_entry> can_router::index() const
+{
+  return m_view.load()->exact;
+}
+
+namespace {
+using acceptance_filter = can_router::acceptance_filter;
+
+std::int64_t accepted_ids(const acceptance_filter& p_filter)
+{
+  auto const free_bits =
+    std::popcount(~p_filter.mask & can_router::extended_id_mask);
+  return std::int64_t{ 1 } << free_bits;
+}
+
+acceptance_filter merge(const acceptance_filter& p_first,
+                        const acceptance_filter& p_second)
+{
+  auto const mask = p_first.mask & p_second.mask & ~(p_first.id ^ p_second.id);
+  return { .id = p_first.id & mask, .mask = mask };
+}
+
+/// True if every ID accepted by p_inner is also accepted by p_outer
+bool covers(const acceptance_filter& p_outer, const acceptance_filter& p_inner)
+{
+  return (p_inner.mask & p_outer.mask) == p_outer.mask &&
+         (p_inner.id & p_outer.mask) == p_outer.id;
+}
+
+/**
+ * @brief Add a filter to a set, merging filters if the set is full
+ *
+ * @param p_filters - all of the storage for the set
+ * @param p_count - number of filters currently in the set
+ * @param p_filter - filter to add
+ * @return std::size_t - new number of filters in the set
+ */
+std::size_t add_filter(std::span<acceptance_filter> p_filters,
+                       std::size_t p_count,
+                       acceptance_filter p_filter)
+{
+  for (auto const& filter : p_filters.first(p_count)) {
+    if (covers(filter, p_filter)) {
+      return p_count;
+    }
+  }
+
+  if (p_count < p_filters.size()) {
+    p_filters[p_count] = p_filter;
+    return p_count + 1;
+  }
+
+  // The new filter takes the place at index p_count while searching for the
+  // pair whose merge accepts the fewest additional IDs.
+  auto const at = [&](std::size_t p_index) {
+    return p_index < p_count ? p_filters[p_index] : p_filter;
+  };
+  std::size_t best_first = 0;
+  std::size_t best_second = 0;
+  auto best_cost = std::numeric_limits<std::int64_t>::max();
+  for (std::size_t i = 0; i <= p_count; i++) {
+    for (std::size_t j = i + 1; j <= p_count; j++) {
+      auto const cost = accepted_ids(merge(at(i), at(j))) -
+                        accepted_ids(at(i)) - accepted_ids(at(j));
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_first = i;
+        best_second = j;
+      }
+    }
+  }
+
+  p_filters[best_first] = merge(at(best_first), at(best_second));
+  if (best_second < p_count) {
+    p_filters[best_second] = p_filter;
+  }
+  return p_count;
+}
+constexpr hal::can::id_t standard_id_mask = 0x7FF;
+constexpr hal::can::id_t extended_only_bits =
+  can_router::extended_id_mask & ~standard_id_mask;
+
+/// True if p_route may match an ID outside of the standard ID space
+template<class Route>
+bool may_match_extended(const Route& p_route)
+{
+  if (p_route.mask == can_router::exact_mask) {
+    auto const last = p_route.id + p_route.range;
+    return last < p_route.id || last > standard_id_mask;
+  }
+  // A mask route comparing every bit above the standard ID against zero can
+  // only match standard IDs. Anything else is assumed to match extended IDs.
+  return p_route.range != 0 ||
+         (p_route.mask & extended_only_bits) != extended_only_bits ||
+         (p_route.id & extended_only_bits) != 0;
+}
+
+/// Bits of the extended ID Bloom filter set for p_id
+std::array<std::size_t, 2> bloom_bits(hal::can::id_t p_id)
+{
+  static_assert(can_router::extended_filter_bits == 1024);
+  auto const hash = static_cast<std::uint32_t>(p_id * 0x9E37'79B1U);
+  return { hash >> 22U, (hash >> 12U) & 0x3FFU };
+}
+
+// The receive handler reads the filter while routes are added and removed, so
+// its words are only accessed through relaxed atomics. Only the context
+// changing routes writes to it.
+LIBHAL_CANROUTER_FAST_CODE
+std::uint32_t load_word(std::uint32_t& p_word)
+{
+  return std::atomic_ref(p_word).load(std::memory_order_relaxed);
+}
+
+void store_word(std::uint32_t& p_word, std::uint32_t p_value)
+{
+  std::atomic_ref(p_word).store(p_value, std::memory_order_relaxed);
+}
+
+void set_bit(std::span<std::uint32_t> p_bits, std::size_t p_bit)
+{
+  auto& word = p_bits[p_bit / 32];
+  store_word(word, load_word(word) | (std::uint32_t{ 1 } << (p_bit % 32)));
+}
+
+LIBHAL_CANROUTER_FAST_CODE
+bool test_bit(std::span<std::uint32_t> p_bits, std::size_t p_bit)
+{
+  return (load_word(p_bits[p_bit / 32]) >> (p_bit % 32)) & 1U;
+}
+
+template<class Route>
+void filter_insert(can_router::id_filter& p_filter, const Route& p_route)
+{
+  if (p_route.exact()) {
+    if (p_route.id <= standard_id_mask) {
+      set_bit(p_filter.standard, p_route.id);
+    } else {
+      for (auto const bit : bloom_bits(p_route.id)) {
+        set_bit(p_filter.extended, bit);
+      }
+    }
+    return;
+  }
+
+  for (hal::can::id_t id = 0; id < can_router::standard_id_count; id++) {
+    if (p_route.matches(id)) {
+      set_bit(p_filter.standard, id);
+    }
+  }
+  if (may_match_extended(p_route)) {
+    std::atomic_ref(p_filter.every_extended)
+      .store(true, std::memory_order_relaxed);
+  }
+}
+
+LIBHAL_CANROUTER_FAST_CODE
+bool may_route(can_router::id_filter& p_filter, hal::can::id_t p_id)
+{
+  if (p_id <= standard_id_mask) {
+    return test_bit(p_filter.standard, p_id);
+  }
+  if (std::atomic_ref(p_filter.every_extended)
+        .load(std::memory_order_relaxed)) {
+    return true;
+  }
+  auto const bits = bloom_bits(p_id);
+  return test_bit(p_filter.extended, bits[0]) &&
+         test_bit(p_filter.extended, bits[1]);
+}
+}  // namespace
+
+/**
+ * @brief Compute hardware acceptance filters for the registered routes
+ *
+ * Produces at most `p_filters.size()` mask filters that together accept every
+ * message routed by this router. Range routes are split into aligned blocks.
+ * When there are more blocks than filters, the pair of filters whose merge
+ * accepts the fewest additional IDs is merged until the set fits.
+ *
+ * The result is meant to be programmed into the CAN peripheral's acceptance
+ * filters, through that peripheral's driver, so that unrouted messages never
+ * raise a receive interrupt. An empty result means that no message needs to
+ * be accepted. While an unrouted callback is set, the result is one filter
+ * accepting every message.
+ *
+ * @param p_filters - storage for the filters, typically one element per
+ * hardware filter bank.
+ * @param p_bus - bus to compute the filters for, skipping routes that only
+ * receive from other buses, or any_bus for the routes of every bus.
+ * @return std::span<acceptance_filter> - portion of p_filters that was filled
+ */
+std::span<can_router::acceptance_filter> can_router::acceptance_filters(
+  std::span<acceptance_filter> p_filters,
+  std::uint8_t p_bus) const
+{
+  if (p_filters.empty()) {
+    return p_filters;
+  }
+
+  if (m_has_unrouted) {
+    p_filters[0] = { .id = 0, .mask = 0 };
+    return p_filters.first(1);
+  }
+
+  std::size_t count = 0;
+  auto const add_route_filters = [&](const auto& p_route) {
+    if (p_bus != any_bus && not p_route.receives_from(p_bus)) {
+      return;
+    }
+    auto const mask = p_route.mask & extended_id_mask;
+    if (p_route.range == 0) {
+      count = add_filter(p_filters,
+                         count,
+                         {
+                           .id = p_route.id & mask,
+                           .mask = mask,
+                         });
       return;
     }
+
+    // Split the range into the largest blocks that are aligned to their size
+    std::uint64_t first = p_route.id & extended_id_mask;
+    std::uint64_t const last = std::min<std::uint64_t>(
+      first + p_route.range, extended_id_mask);
+    while (first <= last) {
+      std::uint64_t block = first == 0 ? extended_id_mask + 1ULL
+                                       : (first & (~first + 1));
+      while (first + block - 1 > last) {
+        block >>= 1;
+      }
+      auto const block_mask =
+        static_cast<hal::can::id_t>(~(block - 1)) & mask;
+      count = add_filter(p_filters,
+                         count,
+                         {
+                           .id = static_cast<hal::can::id_t>(first) &
+                                 block_mask,
+                           .mask = block_mask,
+                         });
+      first += block;
+    }
+  };
+  for (auto const& list_handler : m_handlers) {
+    add_route_filters(list_handler);
+  }
+  for (auto const& list_handler : m_thin_handlers) {
+    add_route_filters(list_handler);
+  }
+
+  // Merging can produce filters that cover others, which are then redundant
+  std::size_t kept = 0;
+  for (std::size_t i = 0; i < count; i++) {
+    bool redundant = false;
+    for (std::size_t j = 0; j < count && not redundant; j++) {
+      if (i == j || not covers(p_filters[j], p_filters[i])) {
+        continue;
+      }
+      // Of two identical filters, only keep the first
+      bool const identical = covers(p_filters[i], p_filters[j]);
+      redundant = not identical || j < i;
+    }
+    if (not redundant) {
+      p_filters[kept++] = p_filters[i];
+    }
+  }
+
+  return p_filters.first(kept);
+}
+
+// Section attributes are ignored on templates, so this is always inlined into
+// its callers to keep it within the receive path's section
+template<class Callable>
+[[gnu::always_inline]] inline auto can_router::visit(
+  const index_entry& p_entry,
+  Callable&& p_callable)
+{
+  if (p_entry.thin) {
+    return p_callable(*static_cast<thin_route*>(p_entry.target));
+  }
+  return p_callable(*static_cast<route*>(p_entry.target));
+}
+
+LIBHAL_CANROUTER_FAST_CODE
+can_router::route_group can_router::find_group(const index_view& p_view,
+                                               hal::can::id_t p_id)
+{
+  if (m_index.empty()) {
+    return {};
+  }
+
+  auto const search = [p_id](std::span<const index_entry> p_entries) {
+    auto const entry = std::lower_bound(
+      p_entries.begin(),
+      p_entries.end(),
+      p_id,
+      [](const index_entry& p_entry, hal::can::id_t p_search) {
+        return p_entry.id < p_search;
+      });
+    return p_entries.subspan(std::distance(p_entries.begin(), entry));
+  };
+
+  // Routes sharing an ID are adjacent within the index, so one lookup finds
+  // every subscriber.
+  std::span<const index_entry> candidates{};
+  if (m_standard_table && p_id < standard_id_count) {
+    auto const position = std::atomic_ref((*m_standard_table)[p_id])
+                            .load(std::memory_order_relaxed);
+    if (position == 0) {
+      return {};
+    }
+    // The table is updated before a new index is published, so it may refer
+    // to an index that is newer than this view. The binary search is used
+    // whenever the position is not the start of this ID's group.
+    auto const standard = p_view.exact.first(p_view.standard_size);
+    auto const offset = static_cast<std::size_t>(position - 1);
+    bool const current = offset < standard.size() &&
+                         standard[offset].id == p_id &&
+                         (offset == 0 || standard[offset - 1].id != p_id);
+    candidates = current ? standard.subspan(offset) : search(standard);
+  } else {
+    // Standard IDs sort before every extended ID, so when they have been
+    // dispatched through the direct table they can be skipped here.
+    auto const skipped = m_standard_table ? p_view.standard_size : 0;
+    candidates = search(p_view.exact.subspan(skipped));
+  }
+
+  std::size_t length = 0;
+  while (length < candidates.size() && candidates[length].id == p_id) {
+    length++;
+  }
+  return { .exact = candidates.first(length) };
+}
+
+LIBHAL_CANROUTER_FAST_CODE
+can_router::route_group can_router::lookup(const index_view& p_view,
+                                           hal::can::id_t p_id)
+{
+  if (m_id_filter && not may_route(*m_id_filter, p_id)) {
+    return { .wildcards = false };
+  }
+
+  if (m_hot_routes.empty() || m_index.empty()) {
+    return find_group(p_view, p_id);
+  }
+
+  for (std::size_t i = 0; i < m_hot_routes.size(); i++) {
+    auto& line = m_hot_routes[i];
+    if (line.generation != p_view.generation || line.id != p_id) {
+      continue;
+    }
+    auto const group = line.group;
+    if (i > 0) {
+      std::swap(line, m_hot_routes[i - 1]);
+    }
+    return group;
+  }
+
+  auto group = find_group(p_view, p_id);
+  group.wildcards =
+    std::any_of(p_view.wildcards.begin(),
+                p_view.wildcards.end(),
+                [p_id](const index_entry& p_entry) {
+                  return visit(p_entry, [p_id](const auto& p_route) {
+                    return p_route.matches(p_id);
+                  });
+                });
+
+  m_hot_routes.back() = hot_route{
+    .id = p_id,
+    .group = group,
+    .generation = p_view.generation,
+  };
+  return group;
+}
+
+// Section attributes are ignored on templates, so this is always inlined into
+// its callers to keep it within the receive path's section
+template<class Callable>
+[[gnu::always_inline]] inline bool can_router::for_each_route(
+  const index_view& p_view,
+  hal::can::id_t p_id,
+  std::uint8_t p_bus,
+  route_group p_group,
+  Callable&& p_callable)
+{
+  bool matched = false;
+
+  if (m_index.empty()) {
+    if (not p_group.wildcards) {
+      return false;
+    }
+    auto const deliver_matching = [&](auto& p_list) {
+      for (auto& list_handler : p_list) {
+        if (list_handler.matches(p_id) && list_handler.receives_from(p_bus)) {
+          p_callable(list_handler);
+          matched = true;
+        }
+      }
+    };
+    deliver_matching(m_handlers);
+    deliver_matching(m_thin_handlers);
+    return matched;
+  }
+
+  for (auto const& entry : p_group.exact) {
+    visit(entry, [&](auto& p_route) {
+      if (p_route.receives_from(p_bus)) {
+        p_callable(p_route);
+        matched = true;
+      }
+    });
+  }
+
+  if (not p_group.wildcards) {
+    return matched;
+  }
+
+  for (auto const& entry : p_view.wildcards) {
+    visit(entry, [&](auto& p_route) {
+      if (p_route.matches(p_id) && p_route.receives_from(p_bus)) {
+        p_callable(p_route);
+        matched = true;
+      }
+    });
+  }
+
+  return matched;
+}
+
+LIBHAL_CANROUTER_FAST_CODE
+void can_router::deliver(const index_view& p_view,
+                         const can::message_t& p_message,
+                         route_group p_group)
+{
+  auto const bus = m_source_bus;
+  bool matched = false;
+  std::uint32_t deferred = 0;
+
+  if (m_deferred_contexts[bus] == 0) {
+    matched = for_each_route(
+      p_view, p_message.id, bus, p_group, [&](auto& p_route) {
+        invoke(p_route, p_message);
+      });
+  } else {
+    matched = for_each_route(
+      p_view, p_message.id, bus, p_group, [&](auto& p_route) {
+        if (not defers(p_route, bus)) {
+          invoke(p_route, p_message);
+        } else if (admits(p_route, p_message)) {
+          deferred |= std::uint32_t{ 1 } << p_route.context;
+        }
+      });
+  }
+
+  push_deferred(deferred, bus, p_message);
+
+  if (not matched) {
+    deliver_unrouted(p_message);
+  }
+
+#if LIBHAL_CANROUTER_INSTRUMENTATION
+  m_received_count++;
+#endif
+}
+
+LIBHAL_CANROUTER_FAST_CODE
+void can_router::deliver_unrouted(const can::message_t& p_message)
+{
+  m_unrouted_count++;
+
+  if (not m_has_unrouted) {
+    return;
+  }
+
+  if (defers(m_unrouted, m_source_bus)) {
+    m_deferred_queues[m_source_bus][m_unrouted.context]->push(p_message);
+  } else {
+    invoke(m_unrouted, p_message);
+  }
+}
+
+// Always inlined into the receive path, as for_each_route(), like the other
+// functions taking either kind of route
+template<class Route>
+[[gnu::always_inline]] inline bool can_router::defers(const Route& p_route,
+                                                      std::uint8_t p_bus) const
+{
+  return p_route.dispatch == dispatch_mode::deferred &&
+         m_deferred_queues[p_bus][p_route.context] != nullptr;
+}
+
+LIBHAL_CANROUTER_FAST_CODE
+void can_router::push_deferred(std::uint32_t p_contexts,
+                               std::uint8_t p_bus,
+                               const can::message_t& p_message)
+{
+  // Each context is given one copy, however many of its routes matched
+  while (p_contexts != 0) {
+    auto const context = std::countr_zero(p_contexts);
+    m_deferred_queues[p_bus][context]->push(p_message);
+    p_contexts &= p_contexts - 1;
+  }
+}
+
+template<class Route, class Callable>
+[[gnu::always_inline]] inline void can_router::run(
+  [[maybe_unused]] Route& p_route,
+  Callable&& p_handler)
+{
+#if LIBHAL_CANROUTER_INSTRUMENTATION
+  auto& statistics = p_route.statistics;
+  statistics.hits++;
+
+  if (m_clock == nullptr) {
+    p_handler();
+    return;
+  }
+
+  auto const start = m_clock->uptime();
+  p_handler();
+  auto const duration = m_clock->uptime() - start;
+
+  statistics.last_received = start;
+  statistics.min_duration = std::min(statistics.min_duration, duration);
+  statistics.max_duration = std::max(statistics.max_duration, duration);
+  statistics.total_duration += duration;
+#else
+  p_handler();
+#endif
+}
+
+template<class Route>
+[[gnu::always_inline]] inline bool can_router::admits(
+  Route& p_route,
+  const can::message_t& p_message)
+{
+  return p_route.policy == nullptr || p_route.policy->admit(p_message);
+}
+
+template<class Route>
+[[gnu::always_inline]] inline bool can_router::admits(
+  Route& p_route,
+  const can_frame& p_frame)
+{
+  return p_route.policy == nullptr || p_route.policy->admit(p_frame);
+}
+
+template<class Route>
+[[gnu::always_inline]] inline void can_router::invoke(
+  Route& p_route,
+  const can::message_t& p_message)
+{
+  if (admits(p_route, p_message)) {
+    handle(p_route, p_message);
+  }
+}
+
+template<class Route>
+[[gnu::always_inline]] inline void can_router::handle(
+  Route& p_route,
+  const can::message_t& p_message)
+{
+  if (p_route.frame_handler) {
+    run(p_route,
+        [&]() { (*p_route.frame_handler)(can_frame::view(p_message)); });
+  } else {
+    run(p_route, [&]() { p_route.handler(p_message); });
+  }
+}
+
+template<class Route>
+[[gnu::always_inline]] inline void can_router::invoke(
+  Route& p_route,
+  const can_frame& p_frame)
+{
+  if (not admits(p_route, p_frame)) {
+    return;
+  }
+
+  run(p_route, [&]() { (*p_route.frame_handler)(p_frame); });
+}
+
+/**
+ * @brief Set a callback for messages that match no route
+ *
+ * Meant for passive bus monitoring or for forwarding unknown traffic. The
+ * callback only runs after the search for routes has failed, so routed
+ * messages are not slowed down by it. While it is set, acceptance_filters()
+ * accepts every message.
+ *
+ * @param p_handler - callback to be executed when an unrouted message is
+ * received.
+ * @param p_dispatch - context the handler runs in while dispatch is deferred
+ */
+void can_router::on_unrouted(message_handler p_handler,
+                             dispatch_mode p_dispatch)
+{
+  m_unrouted.handler = std::move(p_handler);
+  m_unrouted.dispatch = p_dispatch;
+  m_has_unrouted = true;
+}
+
+/**
+ * @brief Remove the callback for messages that match no route
+ *
+ */
+void can_router::clear_unrouted()
+{
+  m_has_unrouted = false;
+  m_unrouted.handler = noop;
+}
+
+/**
+ * @return std::uint32_t - number of received messages that matched no route,
+ * whether or not an unrouted callback is set. Wraps on overflow.
+ */
+std::uint32_t can_router::unrouted_count() const
+{
+  return m_unrouted_count;
+}
+
+/**
+ * @brief Message routing interrupt service handler
+ *
+ * Searches the static list (or the sorted index, if present) and runs the
+ * callback of every route matching the message's ID. Indexed routers run exact
+ * ID routes before mask and range routes, otherwise routes run in the order
+ * they were registered.
+ *
+ * @param p_message - message received from the bus
+ */
+LIBHAL_CANROUTER_FAST_CODE
+void can_router::operator()(const can::message_t& p_message)
+{
+  receive(0, p_message);
+}
+
+// Only routers allowing live updates flag dispatches, since publish_index()
+// only waits for them when it has a spare index to swap in.
+LIBHAL_CANROUTER_FAST_CODE
+bool can_router::begin_dispatch()
+{
+  bool const live = m_live_updates.load(std::memory_order_relaxed);
+  if (live) {
+    m_dispatching.store(true);
+  }
+  return live;
+}
+
+LIBHAL_CANROUTER_FAST_CODE
+void can_router::end_dispatch(bool p_live)
+{
+  if (p_live) {
+    m_dispatching.store(false, std::memory_order_release);
+  }
+}
+
+LIBHAL_CANROUTER_FAST_CODE
+void can_router::receive(std::uint8_t p_bus, const can::message_t& p_message)
+{
+  // Restored on return, in case this preempted poll() while it was running a
+  // handler for a message from another bus.
+  auto const preempted_bus = m_source_bus;
+  m_source_bus = p_bus;
+  if (m_capture) {
+    m_capture->append(p_bus, p_message);
+  }
+  bool const live = begin_dispatch();
+  auto const& view = *m_view.load();
+  deliver(view, p_message, lookup(view, p_message.id));
+  end_dispatch(live);
+  m_source_bus = preempted_bus;
+}
+
+/**
+ * @brief Route a burst of messages
+ *
+ * Meant for drivers that drain several frames from a receive FIFO per
+ * interrupt and can call the router directly. Equivalent to calling the
+ * receive handler for each message in order, except that consecutive messages
+ * with the same ID reuse the previous lookup.
+ *
+ * Handlers must not add or remove routes while a burst is being dispatched.
+ *
+ * @param p_messages - messages received from the bus, oldest first
+ * @param p_bus - bus the messages were received on
+ */
+LIBHAL_CANROUTER_FAST_CODE
+void can_router::dispatch(std::span<const can::message_t> p_messages,
+                          std::uint8_t p_bus)
+{
+  route_group group{};
+  hal::can::id_t group_id = 0;
+  bool has_group = false;
+
+  auto const preempted_bus = m_source_bus;
+  m_source_bus = p_bus;
+  bool const live = begin_dispatch();
+  auto const& view = *m_view.load();
+  for (auto const& message : p_messages) {
+    if (m_capture) {
+      m_capture->append(p_bus, message);
+    }
+    if (not has_group || message.id != group_id) {
+      group = lookup(view, message.id);
+      group_id = message.id;
+      has_group = true;
+    }
+    deliver(view, message, group);
+  }
+  end_dispatch(live);
+  m_source_bus = preempted_bus;
+}
+
+/**
+ * @brief Route a classic or CAN FD frame without copying it
+ *
+ * Meant for drivers that can hand over a view of their receive buffer. Classic
+ * frames are handled as by the receive handler, and routes with a
+ * `frame_handler` running from this call are given the view. CAN FD frames
+ * only run routes with a `frame_handler`, always from this call since the
+ * view does not outlive it. Route policies apply to both. A CAN FD frame
+ * matching no route with a `frame_handler` is counted as unrouted, but not
+ * given to the unrouted callback.
+ *
+ * @param p_frame - frame received from the bus
+ * @param p_bus - bus the frame was received on
+ */
+LIBHAL_CANROUTER_FAST_CODE
+void can_router::dispatch(const can_frame& p_frame, std::uint8_t p_bus)
+{
+  auto const message = p_frame.classic();
+  std::uint32_t deferred = 0;
+
+  // Only routes that can take the frame count as matching it
+  bool handled = false;
+
+  auto const preempted_bus = m_source_bus;
+  m_source_bus = p_bus;
+  if (m_capture) {
+    m_capture->append(p_bus, p_frame);
+  }
+  bool const live = begin_dispatch();
+  auto const& view = *m_view.load();
+  for_each_route(
+    view, p_frame.id, p_bus, lookup(view, p_frame.id), [&](auto& p_route) {
+      if (not message) {
+        if (p_route.frame_handler) {
+          handled = true;
+          invoke(p_route, p_frame);
+        }
+        return;
+      }
+
+      handled = true;
+      if (defers(p_route, p_bus)) {
+        if (admits(p_route, p_frame)) {
+          deferred |= std::uint32_t{ 1 } << p_route.context;
+        }
+      } else if (p_route.frame_handler) {
+        invoke(p_route, p_frame);
+      } else {
+        invoke(p_route, *message);
+      }
+    });
+
+  if (message) {
+    push_deferred(deferred, p_bus, *message);
+  }
+
+  if (not handled && message) {
+    deliver_unrouted(*message);
+  } else if (not handled) {
+    m_unrouted_count++;
+  }
+
+#if LIBHAL_CANROUTER_INSTRUMENTATION
+  m_received_count++;
+#endif
+  end_dispatch(live);
+  m_source_bus = preempted_bus;
+}
+
+/**
+ * @brief Cache the lookups of frequently received IDs
+ *
+ * Each cache line remembers the exact ID routes of one ID and whether any mask
+ * or range route matches it, so a cached ID skips both the binary search and
+ * the search of the mask and range routes. Lines are searched from the front
+ * and a hit swaps the line with the one before it, so the most frequently
+ * received IDs gather at the front of the cache. A miss replaces the last
+ * line. IDs with no route are cached too.
+ *
+ * The cache is only used by the receive handler and dispatch(), and is cleared
+ * whenever a route is added or removed. Linear routers must visit every route
+ * to deliver a message and ignore the cache.
+ *
+ * @param p_cache - storage for the cache, typically 4 to 8 lines, or an empty
+ * span to disable it. Must outlive the router or be replaced before it is
+ * destroyed.
+ */
+void can_router::cache_hot_routes(std::span<hot_route> p_cache)
+{
+  m_hot_routes = p_cache;
+  forget_hot_routes();
+}
+
+/**
+ * @brief Reject messages with no route before searching for routes
+ *
+ * The filter is rebuilt from the current routes and kept up to date as routes
+ * are added. Unrouted standard IDs are then rejected with one bit test and most
+ * unrouted extended IDs with two. Mask and range routes that may match
+ * extended IDs make the filter pass every extended ID.
+ *
+ * An indexed router also updates the filter when a route is removed. A linear
+ * router is not told when routes are removed, so their IDs keep passing the
+ * filter and are searched for as before. Passing the filter again rebuilds it.
+ *
+ * @param p_filter - filter to maintain, or nullptr to stop filtering. Must
+ * outlive the router or be replaced before it is destroyed.
+ */
+void can_router::filter_unrouted(id_filter* p_filter)
+{
+  m_id_filter = p_filter;
+  rebuild_id_filter();
+}
+
+/**
+ * @brief Allow routes to be added and removed while messages are received
+ *
+ * The index is double buffered: changes are made to a working copy that is
+ * published with a single atomic store, and the receive handler always
+ * searches a complete, consistent copy. The receive handler is never blocked
+ * or masked. After publishing, the context making the change waits for a
+ * receive handler that is still searching the previous copy to return.
+ *
+ * Routes must be added and removed from a single context that the receive
+ * handler can preempt, such as the main loop or one task, and never from a
+ * route handler running in the receive handler. Moving a route_item relocates
+ * its route and is not covered: keep route items where add_message_callback()
+ * constructed them. Linear routers cannot be updated while messages are
+ * received.
+ *
+ * @param p_spare_storage - second buffer for the index, the same size as the
+ * index storage. Must outlive the router.
+ * @throws hal::argument_out_of_domain - if the router is not indexed or
+ * p_spare_storage is not the same size as the index storage.
+ */
+void can_router::allow_live_updates(std::span<index_entry> p_spare_storage)
+{
+  if (m_index.empty() || p_spare_storage.size() != m_index.size()) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+
+  m_spare_index = p_spare_storage;
+  m_live_updates.store(true);
+  publish_index();
+}
+
+/**
+ * @brief Defer dispatch of received messages to poll()
+ *
+ * While a queue is set, the receive handler runs routes marked
+ * `dispatch_mode::immediate` and only copies messages for every other route
+ * into the queue, keeping those handlers out of interrupt context. Messages
+ * that match no route are dropped without being queued. The router is the
+ * queue's producer and poll() is its consumer.
+ *
+ * Each bus is deferred separately and needs a queue of its own, since each
+ * bus's receive handler is a separate producer.
+ *
+ * Routes may also be spread over several execution contexts, such as the
+ * cores of a multicore part, through `route::context`. Each context has its
+ * own queue for each bus and runs its routes from poll_context(). A message
+ * is queued once for every context with a matching deferred route, and
+ * routes of a context without a queue for the bus run from the receive
+ * handler.
+ *
+ * @param p_queue - queue for received messages, or nullptr to return to
+ * dispatching from the receive handler. Must outlive the router or be replaced
+ * before it is destroyed.
+ * @param p_bus - bus whose dispatch is deferred
+ * @param p_context - execution context whose routes are deferred
+ * @throws hal::argument_out_of_domain - if no bus has the number p_bus, or
+ * p_context is not less than max_contexts.
+ */
+void can_router::defer_dispatch(can_message_queue* p_queue,
+                                std::uint8_t p_bus,
+                                std::uint8_t p_context)
+{
+  if (p_bus >= m_bus_count || p_context >= max_contexts) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+  m_deferred_queues[p_bus][p_context] = p_queue;
+
+  auto const bit = static_cast<std::uint8_t>(1U << p_context);
+  if (p_queue) {
+    m_deferred_contexts[p_bus] |= bit;
+  } else {
+    m_deferred_contexts[p_bus] &= static_cast<std::uint8_t>(~bit);
+  }
+}
+
+/**
+ * @brief Dispatch messages held in the deferred dispatch queue
+ *
+ * Must be called from a single context, such as the main loop or one task.
+ * Does nothing if dispatch is not deferred. The queues of several buses are
+ * taken from in turn, one message at a time. Only runs the routes of
+ * execution context 0, as poll_context(0) does.
+ *
+ * @param p_max_messages - maximum number of messages to dispatch
+ * @return std::size_t - number of messages dispatched
+ */
+std::size_t can_router::poll(std::size_t p_max_messages)
+{
+  return poll_context(0, p_max_messages);
+}
+
+/**
+ * @brief Dispatch the messages queued for one execution context
+ *
+ * Each context must be polled from a single thread of execution, and
+ * different contexts may be polled at the same time, for example one from
+ * each core. Routes must not be added or removed while a context other than
+ * the one changing them is polling. Queue storage shared between cores must
+ * be coherent between them, which on parts with a data cache usually means
+ * placing it in non-cacheable memory.
+ *
+ * @param p_context - execution context to dispatch the routes of
+ * @param p_max_messages - maximum number of messages to dispatch
+ * @return std::size_t - number of messages dispatched
+ */
+std::size_t can_router::poll_context(std::uint8_t p_context,
+                                     std::size_t p_max_messages)
+{
+  if (p_context >= max_contexts) {
+    return 0;
+  }
+
+  std::size_t dispatched = 0;
+  bool drained = false;
+
+  while (not drained && dispatched < p_max_messages) {
+    drained = true;
+    for (std::uint8_t bus = 0; bus < m_bus_count; bus++) {
+      auto* const queue = m_deferred_queues[bus][p_context];
+      if (queue == nullptr || dispatched == p_max_messages) {
+        continue;
+      }
+      auto const message = queue->pop();
+      if (not message) {
+        continue;
+      }
+      drained = false;
+      // Other contexts may run alongside the receive handler, so only the
+      // first shares its source bus
+      if (p_context == 0) {
+        m_source_bus = bus;
+      }
+      m_context_buses[p_context] = bus;
+      auto const& view = *m_view.load(std::memory_order_acquire);
+      bool const matched = for_each_route(
+        view,
+        message->id,
+        bus,
+        find_group(view, message->id),
+        [&](auto& p_route) {
+          if (p_route.dispatch == dispatch_mode::deferred &&
+              p_route.context == p_context) {
+            handle(p_route, *message);
+          }
+        });
+      if (not matched && m_has_unrouted &&
+          m_unrouted.dispatch == dispatch_mode::deferred &&
+          m_unrouted.context == p_context) {
+        invoke(m_unrouted, *message);
+      }
+      dispatched++;
+    }
+  }
+
+  return dispatched;
+}
+
+/**
+ * @brief Record every received message into a capture ring
+ *
+ * Messages are recorded by the receive handler and dispatch() as they arrive,
+ * before any route runs, whether or not a route matches them. Messages
+ * dispatched later by poll() are not recorded again. CAN FD frames do not fit
+ * a record and are counted by the capture as skipped.
+ *
+ * @param p_capture - ring to record into, or nullptr to stop capturing. Must
+ * outlive the router or be replaced before it is destroyed.
+ */
+void can_router::capture(can_capture* p_capture)
+{
+  m_capture = p_capture;
+}
+
+#if LIBHAL_CANROUTER_INSTRUMENTATION
+/**
+ * @brief Set the clock used to time handlers
+ *
+ * Without a clock, messages and handler runs are still counted but no times
+ * are recorded. Reading the clock twice per handler run adds to the time spent
+ * in the receive handler, so a clock with a cheap uptime() is preferred.
+ *
+ * @param p_clock - clock to time handlers with, or nullptr to stop timing.
+ * Must outlive the router or be replaced before it is destroyed.
+ */
+void can_router::instrument(hal::steady_clock* p_clock)
+{
+  m_clock = p_clock;
+}
+
+/**
+ * @brief Get the router wide dispatch statistics
+ *
+ * Per route statistics are held within each route and can be read through
+ * handlers(), thin_handlers() or route_item::get(). Counters are updated from
+ * the receive handler without synchronization, so reads from another context
+ * may observe a partially updated set.
+ *
+ * @return router_statistics - counts of received and unrouted messages
+ */
+can_router::router_statistics can_router::statistics() const
+{
+  return {
+    .received = m_received_count,
+    .misses = m_unrouted_count,
+  };
+}
+
+/**
+ * @brief Clear the statistics of the router and every route
+ *
+ */
+void can_router::reset_statistics()
+{
+  m_received_count = 0;
+  m_unrouted_count = 0;
+  m_unrouted.statistics = {};
+  for (auto& list_handler : m_handlers) {
+    list_handler.statistics = {};
+  }
+  for (auto& list_handler : m_thin_handlers) {
+    list_handler.statistics = {};
+  }
+}
+#endif
+
+void can_router::listen(std::uint8_t p_bus)
+{
+  m_buses[p_bus]->on_receive([this, p_bus](const can::message_t& p_message) {
+    receive(p_bus, p_message);
+  });
+}
+
+/**
+ * @brief Add a fully specified route
+ *
+ * Meant for routes that need fields the add_message_callback() overloads do
+ * not take, such as a route receiving from a single bus:
+ *
+ *     router.add_route({ .id = 0x100, .handler = handler, .bus = 1 });
+ *
+ * @param p_route - route to register
+ * @return route_item - route item from the linked list that must be stored in
+ * a variable
+ * @throws hal::argument_out_of_domain - if the route's bus is neither any_bus
+ * nor less than max_buses.
+ * @throws hal::resource_unavailable_try_again - if the router is indexed and
+ * the index storage is full.
+ */
+can_router::route_item can_router::add_route(route p_route)
+{
+  return insert_route(m_handlers, std::move(p_route));
+}
+
+/**
+ * @brief Add a fully specified route that refers to its handler
+ *
+ * Meant for footprint sensitive applications with many routes. The route is
+ * dispatched exactly like one given to add_route(), but holds its handler as a
+ * can_handler_ref rather than a hal::callback:
+ *
+ *     router.add_thin_route({ .id = 0x100, .handler = std::ref(handler) });
+ *
+ * A router without an index runs the routes of add_route() matching a message
+ * before its thin routes.
+ *
+ * @param p_route - route to register
+ * @return thin_route_item - route item from the linked list that must be
+ * stored in a variable
+ * @throws hal::argument_out_of_domain - if the route's bus is neither any_bus
+ * nor less than max_buses.
+ * @throws hal::resource_unavailable_try_again - if the router is indexed and
+ * the index storage is full.
+ */
+can_router::thin_route_item can_router::add_thin_route(thin_route p_route)
+{
+  return insert_route(m_thin_handlers, std::move(p_route));
+}
+
+template<class Route>
+can_router::basic_route_item<Route> can_router::insert_route(
+  static_list<Route>& p_list,
+  Route&& p_route)
+{
+  if ((p_route.bus != any_bus && p_route.bus >= max_buses) ||
+      p_route.context >= max_contexts) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+
+  if (not m_index.empty() &&
+      m_index_size + m_wildcard_size == m_index.size()) {
+    hal::safe_throw(hal::resource_unavailable_try_again(this));
+  }
+
+  if (m_id_filter) {
+    filter_insert(*m_id_filter, p_route);
+  }
+
+  // Returned without a move, since moving the item after it has been indexed
+  // would relocate a route that may already be receiving messages.
+  return basic_route_item<Route>(m_index.empty() ? nullptr : this,
+                                 p_list.push_back(std::move(p_route)));
+}
+
+std::span<can_router::index_entry> can_router::wildcard_index()
+{
+  return std::span(m_index).last(m_wildcard_size);
+}
+
+template<class Route>
+void can_router::index_insert(basic_route_item<Route>& p_item)
+{
+  index_entry const new_entry{
+    .id = p_item.get().id,
+    .thin = std::is_same_v<Route, thin_route>,
+    .target = &p_item.get(),
+    .owner = &p_item,
+  };
+
+  if (not p_item.get().exact()) {
+    // Shift the wildcard routes towards the front to append the new route
+    auto const wildcards = std::span(m_index).last(m_wildcard_size + 1);
+    std::move(wildcards.begin() + 1, wildcards.end(), wildcards.begin());
+    wildcards.back() = new_entry;
+    m_wildcard_size++;
+    publish_index();
+    return;
+  }
+
+  auto const id = new_entry.id;
+  auto const active = std::span(m_index).first(m_index_size);
+  // Insert after every entry with the same ID so that routes sharing an ID
+  // keep their registration order.
+  auto const position = std::upper_bound(
+    active.begin(),
+    active.end(),
+    id,
+    [](hal::can::id_t p_id, const index_entry& p_entry) {
+      return p_id < p_entry.id;
+    });
+  auto const offset = std::distance(active.begin(), position);
+
+  std::move_backward(position, active.end(), active.end() + 1);
+  m_index[offset] = new_entry;
+  m_index_size++;
+
+  if (id < standard_id_count) {
+    m_standard_size++;
+  }
+  refresh_standard_table(offset);
+  publish_index();
+}
+
+template<class Route>
+can_router::index_entry* can_router::index_find(const Route& p_route,
+                                                const void* p_owner)
+{
+  if (not p_route.exact()) {
+    for (auto& entry : wildcard_index()) {
+      if (entry.owner == p_owner) {
+        return &entry;
+      }
+    }
+    return nullptr;
+  }
+
+  auto const active = std::span(m_index).first(m_index_size);
+  auto entry = std::lower_bound(
+    active.begin(),
+    active.end(),
+    p_route.id,
+    [](const index_entry& p_entry, hal::can::id_t p_search) {
+      return p_entry.id < p_search;
+    });
+
+  for (; entry != active.end() && entry->id == p_route.id; entry++) {
+    if (entry->owner == p_owner) {
+      return &(*entry);
+    }
+  }
+
+  return nullptr;
+}
+
+template<class Route>
+void can_router::index_erase(basic_route_item<Route>& p_item)
+{
+  auto* entry = index_find(p_item.get(), &p_item);
+  if (entry == nullptr) {
+    return;
+  }
+
+  if (not p_item.get().exact()) {
+    auto const wildcards = wildcard_index();
+    auto const position =
+      wildcards.begin() + std::distance(wildcards.data(), entry);
+    std::move_backward(wildcards.begin(), position, position + 1);
+    m_wildcard_size--;
+    publish_index();
+    rebuild_id_filter();
+    return;
+  }
+
+  auto const id = entry->id;
+  auto const offset = std::distance(m_index.data(), entry);
+  auto const active = std::span(m_index).first(m_index_size);
+  auto const position = active.begin() + offset;
+  std::move(position + 1, active.end(), position);
+  m_index_size--;
+
+  if (id < standard_id_count) {
+    m_standard_size--;
+  }
+
+  if (m_standard_table && id < standard_id_count) {
+    // Any routes remaining for this ID must start at or before the erased
+    // entry, so refreshing from there updates or restores the table entry.
+    auto const remaining = std::span(m_index).first(m_standard_size);
+    auto const group = std::lower_bound(
+      remaining.begin(),
+      remaining.end(),
+      id,
+      [](const index_entry& p_entry, hal::can::id_t p_search) {
+        return p_entry.id < p_search;
+      });
+    if (group == remaining.end() || group->id != id) {
+      std::atomic_ref((*m_standard_table)[id])
+        .store(0, std::memory_order_relaxed);
+    }
+    refresh_standard_table(std::distance(remaining.begin(), group));
+  }
+
+  publish_index();
+  rebuild_id_filter();
+}
+
+template<class Route>
+void can_router::index_relocate(basic_route_item<Route>& p_from,
+                                basic_route_item<Route>& p_to)
+{
+  auto* entry = index_find(p_to.get(), &p_from);
+  if (entry == nullptr) {
+    return;
+  }
+
+  entry->target = &p_to.get();
+  entry->owner = &p_to;
+  publish_index();
+}
+
+void can_router::refresh_standard_table(std::size_t p_from)
+{
+  if (m_standard_table == nullptr) {
+    return;
+  }
+
+  auto const active = std::span(m_index).first(m_standard_size);
+  for (auto i = p_from; i < active.size(); i++) {
+    if (i == 0 || active[i - 1].id != active[i].id) {
+      std::atomic_ref((*m_standard_table)[active[i].id])
+        .store(static_cast<std::uint16_t>(i + 1), std::memory_order_relaxed);
+    }
+  }
+}
+
+void can_router::link_owner(const index_entry& p_entry, can_router* p_router)
+{
+  if (p_entry.thin) {
+    static_cast<thin_route_item*>(p_entry.owner)->m_router = p_router;
+  } else {
+    static_cast<route_item*>(p_entry.owner)->m_router = p_router;
+  }
+}
+
+void can_router::release_route_items()
+{
+  for (auto& entry : std::span(m_index).first(m_index_size)) {
+    link_owner(entry, nullptr);
+  }
+  for (auto& entry : wildcard_index()) {
+    link_owner(entry, nullptr);
+  }
+  m_index_size = 0;
+  m_wildcard_size = 0;
+}
+
+void can_router::publish_index()
+{
+  auto const* current = m_view.load(std::memory_order_relaxed);
+  auto& next = current == &m_views[0] ? m_views[1] : m_views[0];
+  next = index_view{
+    .exact = std::span(m_index).first(m_index_size),
+    .wildcards = wildcard_index(),
+    .standard_size = m_standard_size,
+    .generation = current->generation + 1,
+  };
+  m_view.store(&next);
+
+  if (m_spare_index.empty()) {
+    return;
+  }
+
+  // Wait for a receive handler that loaded the previous view to finish
+  // before the storage behind it becomes the working copy.
+  while (m_dispatching.load()) {
+    continue;
+  }
+
+  auto const exact = std::span(m_index).first(m_index_size);
+  auto const wildcards = wildcard_index();
+  std::copy(exact.begin(), exact.end(), m_spare_index.begin());
+  std::copy(wildcards.begin(),
+            wildcards.end(),
+            m_spare_index.end() - static_cast<std::ptrdiff_t>(m_wildcard_size));
+  std::swap(m_index, m_spare_index);
+}
+
+void can_router::forget_hot_routes()
+{
+  for (auto& line : m_hot_routes) {
+    line.generation = 0;
+  }
+}
+
+void can_router::rebuild_id_filter()
+{
+  if (m_id_filter == nullptr) {
+    return;
+  }
+
+  // Built to the side, so that the bits of routes that remain are never seen
+  // cleared by the receive handler.
+  id_filter filter{};
+
+  if (m_index.empty()) {
+    for (auto const& list_handler : m_handlers) {
+      filter_insert(filter, list_handler);
+    }
+    for (auto const& list_handler : m_thin_handlers) {
+      filter_insert(filter, list_handler);
+    }
+  } else {
+    // The index is up to date while a route is being removed, whereas the
+    // list still holds the route until its item is destroyed.
+    auto const insert = [&filter](const auto& p_route) {
+      filter_insert(filter, p_route);
+    };
+    for (auto const& entry : std::span(m_index).first(m_index_size)) {
+      visit(entry, insert);
+    }
+    for (auto const& entry : wildcard_index()) {
+      visit(entry, insert);
+    }
+  }
+
+  // Copied a word at a time. A receive handler may see old and new words
+  // mixed, which still passes the IDs of every route that remains.
+  for (std::size_t i = 0; i < filter.standard.size(); i++) {
+    store_word(m_id_filter->standard[i], filter.standard[i]);
+  }
+  for (std::size_t i = 0; i < filter.extended.size(); i++) {
+    store_word(m_id_filter->extended[i], filter.extended[i]);
   }
+  std::atomic_ref(m_id_filter->every_extended)
+    .store(filter.every_extended, std::memory_order_relaxed);
 }
+template class can_router::basic_route_item<can_router::route>;
+template class can_router::basic_route_item<can_router::thin_route>;
 }  // namespace hal
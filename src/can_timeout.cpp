@@ -0,0 +1,205 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libhal-canrouter/can_timeout.hpp"
+
+#include <bit>
+#include <utility>
+
+#include <libhal/error.hpp>
+
+namespace hal {
+/**
+ * @brief Construct a new timer wheel
+ *
+ * @param p_slots - storage for the wheel's slots. Must outlive the wheel. More
+ * slots mean fewer timeouts are visited per tick. Timeouts longer than the
+ * number of slots are supported.
+ * @throws hal::argument_out_of_domain - if the number of slots is not a power
+ * of two.
+ */
+can_timeout_wheel::can_timeout_wheel(std::span<can_timeout*> p_slots)
+  : m_slots(p_slots)
+{
+  if (not std::has_single_bit(m_slots.size())) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+  for (auto& slot : m_slots) {
+    slot = nullptr;
+  }
+}
+
+/**
+ * @brief Advance time by one tick and handle the deadlines that fall on it
+ *
+ * Timeout callbacks run from here and may construct, destroy or restart
+ * timeouts. Must be called from a single context, which is also the only
+ * context that may construct, destroy or restart timeouts.
+ */
+void can_timeout_wheel::tick()
+{
+  auto const now = m_now.load(std::memory_order_relaxed) + 1;
+  m_now.store(now, std::memory_order_relaxed);
+
+  // Timeouts that stay in this slot are pushed onto the emptied slot, so the
+  // detached list only holds timeouts that have not been visited yet. It is
+  // kept in the wheel so that callbacks removing timeouts also unlink them
+  // from it.
+  auto& slot = m_slots[now & (m_slots.size() - 1)];
+  m_pending = slot;
+  slot = nullptr;
+
+  while (m_pending) {
+    auto& timeout = *m_pending;
+    m_pending = timeout.m_next;
+
+    if (timeout.m_deadline != now) {
+      // Deadline is one or more turns of the wheel away
+      schedule(timeout, timeout.m_deadline);
+      continue;
+    }
+
+    auto const last_seen = timeout.m_last_seen.load(std::memory_order_relaxed);
+    if (now - last_seen < timeout.m_length) {
+      timeout.m_expired = false;
+      schedule(timeout, last_seen + timeout.m_length);
+      continue;
+    }
+
+    // Checked again one length later to notice messages resuming
+    schedule(timeout, now + timeout.m_length);
+    if (not timeout.m_expired) {
+      timeout.m_expired = true;
+      timeout.m_handler();
+    }
+  }
+}
+
+/**
+ * @return std::uint32_t - number of ticks since construction. Wraps on
+ * overflow.
+ */
+std::uint32_t can_timeout_wheel::now() const
+{
+  return m_now.load(std::memory_order_relaxed);
+}
+
+void can_timeout_wheel::schedule(can_timeout& p_timeout,
+                                 std::uint32_t p_deadline)
+{
+  auto& slot = m_slots[p_deadline & (m_slots.size() - 1)];
+  p_timeout.m_deadline = p_deadline;
+  p_timeout.m_next = slot;
+  slot = &p_timeout;
+}
+
+void can_timeout_wheel::remove(can_timeout& p_timeout)
+{
+  for (auto** link : { &m_slots[p_timeout.m_deadline & (m_slots.size() - 1)],
+                       &m_pending }) {
+    while (*link && *link != &p_timeout) {
+      link = &(*link)->m_next;
+    }
+    if (*link) {
+      *link = p_timeout.m_next;
+      return;
+    }
+  }
+}
+
+/**
+ * @brief Construct a new timeout and start supervising
+ *
+ * The first deadline is one timeout's length after construction. Must be
+ * constructed from the context calling the wheel's tick().
+ *
+ * @param p_wheel - wheel tracking the deadline. Must outlive the timeout.
+ * @param p_length - ticks without a message before the timeout expires,
+ * typically a few times the period of the supervised message. Must not be
+ * zero.
+ * @param p_handler - callback to be executed when the timeout expires
+ * @throws hal::argument_out_of_domain - if p_length is zero.
+ */
+can_timeout::can_timeout(can_timeout_wheel& p_wheel,
+                         std::uint32_t p_length,
+                         hal::callback<timeout_handler> p_handler)
+  : m_wheel(&p_wheel)
+  , m_handler(std::move(p_handler))
+  , m_length(p_length)
+{
+  if (m_length == 0) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+  auto const now = m_wheel->now();
+  m_last_seen.store(now, std::memory_order_relaxed);
+  m_wheel->schedule(*this, now + m_length);
+}
+
+/**
+ * @brief Stop supervising
+ *
+ * Must be destroyed from the context calling the wheel's tick().
+ */
+can_timeout::~can_timeout()
+{
+  m_wheel->remove(*this);
+}
+
+/**
+ * @brief Restart the timeout on reception of a message
+ *
+ * Only records the current tick, so it is safe and constant time to call from
+ * the receive handler.
+ *
+ * @param p_message - message received for the supervised route
+ */
+LIBHAL_CANROUTER_FAST_CODE
+void can_timeout::operator()([[maybe_unused]] const can::message_t& p_message)
+{
+  m_last_seen.store(m_wheel->now(), std::memory_order_relaxed);
+}
+
+/**
+ * @brief Restart the timeout as if a message had been seen at a given tick
+ *
+ * Clears the expired state, so the callback runs again once the timeout's
+ * length has passed since p_since. Unlike operator(), this moves the timeout
+ * within the wheel and must be called from the context calling the wheel's
+ * tick(), which includes the timeout's own callback.
+ *
+ * @param p_since - tick to measure the next deadline from. Must not be in the
+ * future.
+ */
+void can_timeout::restart(std::uint32_t p_since)
+{
+  auto const now = m_wheel->now();
+  m_last_seen.store(p_since, std::memory_order_relaxed);
+  m_expired = false;
+  m_wheel->remove(*this);
+
+  // A deadline already passed is handled on the next tick
+  auto const elapsed = now - p_since;
+  auto const remaining = elapsed < m_length ? m_length - elapsed : 1;
+  m_wheel->schedule(*this, now + remaining);
+}
+
+/**
+ * @return true - if the timeout has expired and no message has been seen at a
+ * deadline since
+ */
+bool can_timeout::expired() const
+{
+  return m_expired;
+}
+}  // namespace hal
@@ -0,0 +1,176 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libhal-canrouter/can_transmit_queue.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#include <libhal/error.hpp>
+
+namespace hal {
+namespace {
+constexpr hal::can::id_t standard_id_max = 0x7FF;
+
+/**
+ * @brief Position of a message in bus arbitration, lower values win
+ *
+ * Follows the order of the arbitration field: the 11 base ID bits, then
+ * RTR/SRR and IDE, which are dominant for a standard data frame and recessive
+ * for an extended frame, then the 18 extension bits and the extended RTR bit.
+ */
+std::uint64_t arbitration_key(const can::message_t& p_message)
+{
+  std::uint64_t const remote = p_message.is_remote_request ? 1 : 0;
+  if (p_message.id <= standard_id_max) {
+    return (std::uint64_t{ p_message.id } << 21U) | (remote << 20U);
+  }
+  auto const base = (p_message.id >> 18U) & standard_id_max;
+  auto const extension = p_message.id & 0x3'FFFFU;
+  return (std::uint64_t{ base } << 21U) | (0b11U << 19U) |
+         (std::uint64_t{ extension } << 1U) | remote;
+}
+
+/**
+ * @brief Holds a critical section for the lifetime of the guard
+ */
+class critical_section_guard
+{
+public:
+  explicit critical_section_guard(
+    can_transmit_queue::critical_section& p_critical_section)
+    : m_critical_section(&p_critical_section)
+  {
+    (*m_critical_section)(true);
+  }
+
+  critical_section_guard(critical_section_guard& p_other) = delete;
+  critical_section_guard& operator=(critical_section_guard& p_other) = delete;
+
+  ~critical_section_guard()
+  {
+    (*m_critical_section)(false);
+  }
+
+private:
+  can_transmit_queue::critical_section* m_critical_section;
+};
+}  // namespace
+
+/**
+ * @brief Construct a new can transmit queue
+ *
+ * @param p_bus - bus to send messages on. Must outlive the queue.
+ * @param p_storage - storage for waiting messages. Must outlive the queue.
+ * @param p_critical_section - entered by send() and drain() while they change
+ * the queue. The default does nothing, for queues used from a single context.
+ * @throws hal::argument_out_of_domain - if p_storage is empty
+ */
+can_transmit_queue::can_transmit_queue(hal::can& p_bus,
+                                       std::span<can::message_t> p_storage,
+                                       critical_section p_critical_section)
+  : m_bus(&p_bus)
+  , m_critical_section(std::move(p_critical_section))
+  , m_storage(p_storage)
+{
+  if (m_storage.empty()) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+}
+
+/**
+ * @brief Queue a message to be sent
+ *
+ * @param p_message - message to send
+ * @return true - if the message was queued or replaced a waiting message with
+ * the same ID
+ * @return false - if the queue was full and the message was dropped
+ */
+bool can_transmit_queue::send(const can::message_t& p_message)
+{
+  auto const key = arbitration_key(p_message);
+  critical_section_guard const guard(m_critical_section);
+  auto const waiting = m_storage.first(m_size);
+  // Waiting messages are sorted by descending key
+  auto const position = std::lower_bound(
+    waiting.begin(),
+    waiting.end(),
+    key,
+    [](const can::message_t& p_waiting, std::uint64_t p_key) {
+      return arbitration_key(p_waiting) > p_key;
+    });
+
+  if (position != waiting.end() && arbitration_key(*position) == key) {
+    *position = p_message;
+    m_coalesced_count++;
+    return true;
+  }
+
+  if (m_size == m_storage.size()) {
+    m_overflow_count++;
+    return false;
+  }
+
+  std::move_backward(position, waiting.end(), waiting.end() + 1);
+  *position = p_message;
+  m_size++;
+  return true;
+}
+
+/**
+ * @brief Send waiting messages, highest priority first
+ *
+ * Stops early when the bus rejects a message, for example because its transmit
+ * mailboxes are full. That message stays at the front of the queue for the
+ * next call.
+ *
+ * @param p_max_messages - maximum number of messages to send
+ * @return std::size_t - number of messages sent
+ */
+std::size_t can_transmit_queue::drain(std::size_t p_max_messages)
+{
+  std::size_t sent = 0;
+  critical_section_guard const guard(m_critical_section);
+  while (m_size > 0 && sent < p_max_messages) {
+    try {
+      m_bus->send(m_storage[m_size - 1]);
+    } catch (const hal::exception&) {
+      break;
+    }
+    m_size--;
+    sent++;
+  }
+  return sent;
+}
+
+std::size_t can_transmit_queue::size() const
+{
+  return m_size;
+}
+
+std::size_t can_transmit_queue::capacity() const
+{
+  return m_storage.size();
+}
+
+std::uint32_t can_transmit_queue::coalesced_count() const
+{
+  return m_coalesced_count;
+}
+
+std::uint32_t can_transmit_queue::overflow_count() const
+{
+  return m_overflow_count;
+}
+}  // namespace hal
@@ -0,0 +1,67 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+
+namespace hal {
+/**
+ * @brief Position arithmetic shared by the library's lock free rings
+ *
+ * Read and write positions run over twice the capacity, so that a full ring
+ * and an empty ring can be told apart without giving up a slot. Always inlined
+ * so that it stays within the section of the receive path calling it.
+ */
+struct ring_position
+{
+  std::size_t capacity = 0;
+
+  /**
+   * @param p_position - position to advance
+   * @return std::size_t - position following p_position
+   */
+  [[gnu::always_inline]] constexpr std::size_t advance(
+    std::size_t p_position) const
+  {
+    auto const next = p_position + 1;
+    return next == 2 * capacity ? 0 : next;
+  }
+
+  /**
+   * @param p_write - write position
+   * @param p_read - read position
+   * @return std::size_t - number of elements between the two positions
+   */
+  [[gnu::always_inline]] constexpr std::size_t distance(
+    std::size_t p_write,
+    std::size_t p_read) const
+  {
+    if (p_write >= p_read) {
+      return p_write - p_read;
+    }
+    return (2 * capacity) - p_read + p_write;
+  }
+
+  /**
+   * @param p_position - position within the ring
+   * @return std::size_t - index of the position's element in the storage
+   */
+  [[gnu::always_inline]] constexpr std::size_t index(
+    std::size_t p_position) const
+  {
+    return p_position >= capacity ? p_position - capacity : p_position;
+  }
+};
+}  // namespace hal
@@ -0,0 +1,121 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <libhal-canrouter/can_capture.hpp>
+
+#include <array>
+
+#include <libhal-canrouter/can_router.hpp>
+#include <libhal/error.hpp>
+#include <libhal/functional.hpp>
+
+#include <boost/ut.hpp>
+
+#include "helpers.hpp"
+
+namespace hal {
+void can_capture_test()
+{
+  using namespace boost::ut;
+
+  "can_capture::can_capture() empty storage"_test = []() {
+    // Setup
+    mock_steady_clock clock;
+
+    // Exercise & Verify
+    expect(throws<hal::argument_out_of_domain>(
+      [&]() { can_capture capture(clock, {}); }));
+  };
+
+  "can_router::capture()"_test = []() {
+    // Setup
+    mock_can mock;
+    mock_steady_clock clock;
+    std::array<can_capture::record, 3> storage{};
+    can_capture capture(clock, storage);
+    can_router router(mock);
+    int heartbeats = 0;
+    auto heartbeat = router.add_message_callback(
+      0x700, [&heartbeats](const can::message_t&) { heartbeats++; });
+    std::array<can_capture::record, 2> drained{};
+    router.capture(&capture);
+
+    // Exercise
+    clock.m_uptime = 0x1'0000'0010;
+    mock.m_handler(
+      can::message_t{ .id = 0x700, .payload = { 5 }, .length = 1 });
+    clock.m_uptime = 0x1'0000'0020;
+    mock.m_handler(can::message_t{ .id = 0x123, .is_remote_request = true });
+    std::array const burst{
+      can::message_t{ .id = 0x1AB, .payload = { 1, 2 }, .length = 2 },
+      can::message_t{ .id = 0x1AC },
+    };
+    router.dispatch(burst);
+
+    // Verify
+    expect(that % 1.0_MHz == capture.frequency());
+    expect(that % 1 == heartbeats);
+    expect(that % 3 == capture.size());
+    expect(that % 1 == capture.overflow_count());
+
+    // Exercise
+    auto const count = capture.read(drained);
+
+    // Verify
+    expect(that % 2 == count);
+    expect(that % 0x10 == drained[0].timestamp);
+    expect(that % 0x700 == drained[0].id);
+    expect(that % 1 == drained[0].length);
+    expect(that % 5 == drained[0].message().payload[0]);
+    expect(that % 0x20 == drained[1].timestamp);
+    expect(drained[1].message().is_remote_request);
+    expect(that % 1 == capture.size());
+
+    // Exercise
+    router.capture(nullptr);
+    mock.m_handler(can::message_t{ .id = 0x700 });
+    auto const remaining = capture.read(drained);
+
+    // Verify
+    expect(that % 1 == remaining);
+    expect(that % 0x1AB == drained[0].id);
+    expect(that % 2 == drained[0].payload[1]);
+    expect(that % 0 == capture.size());
+  };
+
+  "can_router::capture() CAN FD frames"_test = []() {
+    // Setup
+    mock_can mock;
+    mock_steady_clock clock;
+    std::array<can_capture::record, 3> storage{};
+    can_capture capture(clock, storage);
+    can_router router(mock);
+    std::array<hal::byte, can_fd_max_payload> buffer{ 7 };
+    std::array<can_capture::record, 3> drained{};
+    router.capture(&capture);
+
+    // Exercise
+    router.dispatch(can_frame{ .id = 0x300, .payload = buffer, .is_fd = true });
+    router.dispatch(
+      can_frame{ .id = 0x301, .payload = std::span(buffer).first(1) });
+    auto const count = capture.read(drained);
+
+    // Verify
+    expect(that % 1 == count);
+    expect(that % 0x301 == drained[0].id);
+    expect(that % 7 == drained[0].payload[0]);
+    expect(that % 1 == capture.skipped_count());
+    expect(that % 0 == capture.overflow_count());
+  };
+};
+}  // namespace hal
@@ -0,0 +1,136 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-canrouter/can_forwarder.hpp>
+
+#include <cstddef>
+#include <functional>
+
+#include <libhal-canrouter/can_router.hpp>
+#include <libhal/error.hpp>
+#include <libhal/functional.hpp>
+
+#include <boost/ut.hpp>
+
+#include "helpers.hpp"
+
+namespace hal {
+void can_forwarder_test()
+{
+  using namespace boost::ut;
+
+  "can_forwarder::operator()"_test = []() {
+    // Setup
+    mock_can destination;
+    mock_steady_clock clock;
+    can_forwarder forwarder(destination, { .keep = 0x0FF, .set = 0x500 });
+    forwarder.limit_rate(&clock, std::chrono::milliseconds(10));
+
+    // Exercise
+    clock.m_uptime = 1'000;
+    forwarder(can::message_t{ .id = 0x123, .payload = { 7 }, .length = 1 });
+    clock.m_uptime = 5'000;
+    forwarder(can::message_t{ .id = 0x123, .payload = { 8 }, .length = 1 });
+
+    // Verify
+    expect(that % 1 == destination.m_sent.size());
+    expect(that % 0x523 == destination.m_sent.back().id);
+    expect(that % 7 == destination.m_sent.back().payload[0]);
+    expect(that % 1 == forwarder.forwarded_count());
+    expect(that % 1 == forwarder.suppressed_count());
+
+    // Exercise
+    clock.m_uptime = 11'000;
+    destination.m_busy = true;
+    forwarder(can::message_t{ .id = 0x123 });
+    destination.m_busy = false;
+    clock.m_uptime = 12'000;
+    forwarder(can::message_t{ .id = 0x125 });
+
+    // Verify
+    expect(that % 1 == forwarder.dropped_count());
+    expect(that % 1 == forwarder.suppressed_count());
+    expect(that % 2 == forwarder.forwarded_count());
+    expect(that % 0x525 == destination.m_sent.back().id);
+
+    // Exercise
+    forwarder.limit_rate(nullptr, {});
+    forwarder(can::message_t{ .id = 0x124 });
+
+    // Verify
+    expect(that % 3 == forwarder.forwarded_count());
+    expect(that % 0x524 == destination.m_sent.back().id);
+  };
+
+  "can_router::add_forward()"_test = []() {
+    // Setup
+    mock_can first_bus;
+    mock_can second_bus;
+    std::array<can::message_t, 2> queue_storage{};
+    can_message_queue queue(queue_storage);
+    std::array<can_router::index_entry, 4> index_storage{};
+    can_router router(first_bus, index_storage);
+    auto const second = router.attach(second_bus);
+    can_forwarder to_second(second_bus);
+    router.defer_dispatch(&queue);
+    auto status = router.add_forward(0x100, to_second, 0);
+    auto diagnostics = router.add_forward(
+      can_router::id_mask{ .value = 0x700, .mask = 0x700 }, to_second, 0);
+
+    // Exercise
+    first_bus.m_handler(can::message_t{ .id = 0x100, .payload = { 1 } });
+    first_bus.m_handler(can::message_t{ .id = 0x7DF, .payload = { 2 } });
+    second_bus.m_handler(can::message_t{ .id = 0x100, .payload = { 3 } });
+    first_bus.m_handler(can::message_t{ .id = 0x200, .payload = { 4 } });
+
+    // Verify
+    expect(that % 1 == second);
+    expect(that % 2 == second_bus.m_sent.size());
+    expect(that % 0x7DF == second_bus.m_sent.back().id);
+    expect(that % 2 == second_bus.m_sent.back().payload[0]);
+    expect(that % 0 == first_bus.m_sent.size());
+    expect(that % 0 == queue.size());
+  };
+
+  "can_router::add_thin_route() forwarding"_test = []() {
+    // Setup
+    mock_can first_bus;
+    mock_can second_bus;
+    std::array<can::message_t, 2> queue_storage{};
+    can_message_queue queue(queue_storage);
+    std::array<can_router::index_entry, 4> index_storage{};
+    can_router router(first_bus, index_storage);
+    auto const second = router.attach(second_bus);
+    can_forwarder to_second(second_bus, { .keep = 0x0FF, .set = 0x500 });
+    router.defer_dispatch(&queue);
+    auto status = router.add_thin_route(
+      { .id = 0x100,
+        .handler = std::ref(to_second),
+        .dispatch = can_router::dispatch_mode::immediate,
+        .bus = 0 });
+
+    // Exercise
+    first_bus.m_handler(can::message_t{ .id = 0x100, .payload = { 1 } });
+    second_bus.m_handler(can::message_t{ .id = 0x100, .payload = { 2 } });
+
+    // Verify
+    expect(that % 1 == second);
+    expect(that % 1 == second_bus.m_sent.size());
+    expect(that % 0x500 == second_bus.m_sent.back().id);
+    expect(that % 1 == second_bus.m_sent.back().payload[0]);
+    expect(that % 1 == to_second.forwarded_count());
+    expect(that % 0 == queue.size());
+  };
+};
+}  // namespace hal
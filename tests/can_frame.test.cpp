@@ -0,0 +1,169 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <libhal-canrouter/can_frame.hpp>
+
+#include <array>
+#include <cstddef>
+
+#include <libhal-canrouter/can_route_policy.hpp>
+#include <libhal-canrouter/can_router.hpp>
+#include <libhal/error.hpp>
+#include <libhal/functional.hpp>
+
+#include <boost/ut.hpp>
+
+#include "helpers.hpp"
+
+namespace hal {
+void can_frame_test()
+{
+  using namespace boost::ut;
+
+  "can_frame::classic()"_test = []() {
+    // Setup
+    can::message_t const message{ .id = 0x120,
+                                  .payload = { 1, 2, 3, 4 },
+                                  .length = 3 };
+    std::array<hal::byte, can_fd_max_payload> fd_payload{};
+
+    // Exercise
+    auto const frame = can_frame::view(message);
+    auto const classic = frame.classic();
+    auto const fd =
+      can_frame{ .id = 0x120, .payload = fd_payload, .is_fd = true };
+
+    // Verify
+    expect(that % 3 == frame.payload.size());
+    expect(frame.payload.data() == message.payload.data());
+    expect(classic.has_value());
+    expect(that % 3 == classic->length);
+    expect(that % 3 == classic->payload[2]);
+    expect(that % 0 == classic->payload[3]);
+    expect(not fd.classic().has_value());
+  };
+
+  "can_router::dispatch() frames"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can::message_t, 4> queue_storage{};
+    can_message_queue queue(queue_storage);
+    can_router router(mock);
+    std::size_t frame_length = 0;
+    const hal::byte* frame_data = nullptr;
+    int frames = 0;
+    int messages = 0;
+    can_frame_handler on_frame = [&](const can_frame& p_frame) {
+      frames++;
+      frame_length = p_frame.payload.size();
+      frame_data = p_frame.payload.data();
+    };
+    auto fd_route =
+      router.add_route({ .id = 0x300, .frame_handler = &on_frame });
+    auto classic_route = router.add_message_callback(
+      0x300, [&](const can::message_t&) { messages++; });
+    std::array<hal::byte, can_fd_max_payload> buffer{};
+    router.defer_dispatch(&queue);
+
+    // Exercise
+    router.dispatch(can_frame{ .id = 0x300, .payload = buffer, .is_fd = true });
+
+    // Verify
+    expect(that % 1 == frames);
+    expect(that % can_fd_max_payload == frame_length);
+    expect(frame_data == buffer.data());
+    expect(that % 0 == queue.size());
+
+    // Exercise
+    router.dispatch(
+      can_frame{ .id = 0x300, .payload = std::span(buffer).first(8) });
+    router.dispatch(can_frame{ .id = 0x301, .payload = buffer, .is_fd = true });
+
+    // Verify
+    expect(that % 1 == frames);
+    expect(that % 0 == messages);
+    expect(that % 1 == queue.size());
+    expect(that % 1 == router.unrouted_count());
+
+    // Exercise
+    router.poll();
+    mock.m_handler(can::message_t{ .id = 0x300, .length = 2 });
+    router.poll();
+
+    // Verify
+    expect(that % 2 == messages);
+    expect(that % 3 == frames);
+    expect(that % 2 == frame_length);
+    expect(frame_data != buffer.data());
+  };
+
+  "can_router::dispatch() CAN FD policies and unrouted"_test = []() {
+    // Setup
+    mock_can mock;
+    can_router router(mock);
+    can_route_policy policy;
+    int frames = 0;
+    int messages = 0;
+    int unrouted = 0;
+    can_frame_handler on_frame = [&](const can_frame&) { frames++; };
+    policy.decimate(2);
+    auto fd_route = router.add_route(
+      { .id = 0x300, .policy = &policy, .frame_handler = &on_frame });
+    auto classic_route = router.add_message_callback(
+      0x301, [&](const can::message_t&) { messages++; });
+    router.on_unrouted([&](const can::message_t&) { unrouted++; });
+    std::array<hal::byte, can_fd_max_payload> buffer{};
+
+    // Exercise
+    for (int i = 0; i < 4; i++) {
+      router.dispatch(
+        can_frame{ .id = 0x300, .payload = buffer, .is_fd = true });
+    }
+    router.dispatch(can_frame{ .id = 0x301, .payload = buffer, .is_fd = true });
+
+    // Verify
+    expect(that % 2 == frames);
+    expect(that % 2 == policy.suppressed().decimated);
+    expect(that % 0 == messages);
+    expect(that % 0 == unrouted);
+    expect(that % 1 == router.unrouted_count());
+  };
+
+  "can_route_policy::admit() CAN FD frame"_test = []() {
+    // Setup
+    can_route_policy policy;
+    std::array<hal::byte, can_fd_max_payload> buffer{ 1, 2, 3 };
+    auto const fd = can_frame{ .id = 0x300, .payload = buffer, .is_fd = true };
+    auto const short_fd = can_frame{ .id = 0x300,
+                                     .payload = std::span(buffer).first(3),
+                                     .is_fd = true };
+    can::message_t const message{ .id = 0x300,
+                                  .payload = { 1, 2, 3, 9 },
+                                  .length = 3 };
+    policy.only_on_change(true);
+
+    // Exercise
+    bool const first = policy.admit(fd);
+    bool const second = policy.admit(fd);
+    bool const third = policy.admit(short_fd);
+    bool const fourth = policy.admit(message);
+
+    // Verify
+    expect(first);
+    expect(second);
+    expect(third);
+    expect(not fourth);
+    expect(that % 1 == policy.suppressed().unchanged);
+  };
+};
+}  // namespace hal
@@ -0,0 +1,165 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <libhal-canrouter/can_handler_ref.hpp>
+
+#include <cstdint>
+#include <array>
+#include <functional>
+
+#include <libhal-canrouter/can_mux.hpp>
+#include <libhal-canrouter/can_router.hpp>
+#include <libhal/error.hpp>
+#include <libhal/functional.hpp>
+
+#include <boost/ut.hpp>
+
+#include "helpers.hpp"
+
+namespace hal {
+namespace {
+struct counter
+{
+  int count = 0;
+  hal::byte last = 0;
+
+  void operator()(const can::message_t& p_message)
+  {
+    count++;
+    last = p_message.payload[0];
+  }
+};
+
+int free_function_calls = 0;
+
+void free_function([[maybe_unused]] const can::message_t& p_message)
+{
+  free_function_calls++;
+}
+}  // namespace
+
+void can_handler_ref_test()
+{
+  using namespace boost::ut;
+
+  "can_handler_ref::operator()"_test = []() {
+    // Setup
+    counter object;
+    int context_calls = 0;
+    can_handler_ref const ignore;
+    can_handler_ref const to_object = std::ref(object);
+    can_handler_ref const to_lambda = [](const can::message_t&) {
+      free_function_calls += 10;
+    };
+    can_handler_ref const to_function = free_function;
+    can_handler_ref const to_thunk(
+      [](void* p_context, const can::message_t&) {
+        (*static_cast<int*>(p_context))++;
+      },
+      &context_calls);
+    free_function_calls = 0;
+    can::message_t const message{ .id = 0x100, .payload = { 7 } };
+
+    // Exercise
+    ignore(message);
+    to_object(message);
+    to_lambda(message);
+    to_function(message);
+    to_thunk(message);
+
+    // Verify
+    expect(that % 2 * sizeof(void*) == sizeof(can_handler_ref));
+    expect(that % 1 == object.count);
+    expect(that % 7 == object.last);
+    expect(that % 11 == free_function_calls);
+    expect(that % 1 == context_calls);
+  };
+
+  "can_router thin route handlers"_test = []() {
+    // Setup
+    mock_can mock;
+    can_router router(mock);
+    counter object;
+    free_function_calls = 0;
+    auto by_reference = router.add_message_callback(0x100, std::ref(object));
+    auto by_function = router.add_message_callback(0x100, free_function);
+    auto by_lambda = router.add_message_callback(
+      0x200, [](const can::message_t&) { free_function_calls += 10; });
+
+    // Exercise
+    mock.m_handler(can::message_t{ .id = 0x100, .payload = { 3 } });
+    mock.m_handler(can::message_t{ .id = 0x200 });
+
+    // Verify
+    expect(that % 1 == object.count);
+    expect(that % 3 == object.last);
+    expect(that % 11 == free_function_calls);
+  };
+
+  "can_router::add_thin_route()"_test = []() {
+    // Setup
+    mock_can mock;
+    can_router router(mock);
+    counter object;
+    counter unrouted;
+    counter selected;
+    int context_calls = 0;
+    free_function_calls = 0;
+    std::array<can_mux::message_handler, 4> table{};
+    can_mux mux(table, { .byte = 0, .shift = 0, .width = 2 });
+    mux.set(1, std::ref(selected));
+    mux.set(2, free_function);
+    auto by_reference =
+      router.add_thin_route({ .id = 0x100, .handler = std::ref(object) });
+    auto by_function =
+      router.add_thin_route({ .id = 0x100, .handler = free_function });
+    auto by_thunk = router.add_thin_route(
+      { .id = 0x100,
+        .handler = can_handler_ref(
+          [](void* p_context, const can::message_t&) {
+            (*static_cast<int*>(p_context))++;
+          },
+          &context_calls) });
+    auto by_mux =
+      router.add_thin_route({ .id = 0x200, .handler = std::ref(mux) });
+    auto by_callback = router.add_message_callback(
+      0x100, [](const can::message_t&) { free_function_calls += 10; });
+    router.on_unrouted(std::ref(unrouted));
+
+    // Exercise
+    mock.m_handler(can::message_t{ .id = 0x100, .payload = { 3 } });
+    mock.m_handler(
+      can::message_t{ .id = 0x200, .payload = { 1 }, .length = 1 });
+    mock.m_handler(
+      can::message_t{ .id = 0x200, .payload = { 2 }, .length = 1 });
+    mock.m_handler(
+      can::message_t{ .id = 0x200, .payload = { 3 }, .length = 1 });
+    mock.m_handler(can::message_t{ .id = 0x300, .payload = { 9 } });
+
+    // Verify
+    expect(that % sizeof(can_handler_ref) ==
+           sizeof(can_router::thin_route::handler));
+    expect(that % 4 == router.thin_handlers().size());
+    expect(that % 1 == router.handlers().size());
+    expect(that % 1 == object.count);
+    expect(that % 3 == object.last);
+    expect(that % 12 == free_function_calls);
+    expect(that % 1 == context_calls);
+    expect(that % 1 == selected.count);
+    expect(that % 1 == mux.unselected_count());
+    expect(that % 1 == unrouted.count);
+    expect(that % 9 == unrouted.last);
+    expect(that % 1 == router.unrouted_count());
+  };
+};
+}  // namespace hal
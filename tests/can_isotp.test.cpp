@@ -0,0 +1,148 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-canrouter/can_isotp.hpp>
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include <libhal-canrouter/can_router.hpp>
+#include <libhal/error.hpp>
+#include <libhal/functional.hpp>
+
+#include <boost/ut.hpp>
+
+#include "helpers.hpp"
+
+namespace hal {
+namespace {
+can::message_t frame(std::array<hal::byte, 8> p_payload)
+{
+  return { .id = 0x7E0, .payload = p_payload, .length = 8 };
+}
+}  // namespace
+
+void can_isotp_test()
+{
+  using namespace boost::ut;
+
+  "can_isotp_pool::acquire() & release()"_test = []() {
+    // Setup
+    std::array<hal::byte, 70> storage{};
+    can_isotp_pool pool(storage, 32);
+
+    // Exercise
+    auto const first = pool.acquire();
+    auto const second = pool.acquire();
+    auto const exhausted = pool.acquire();
+    pool.release(first);
+
+    // Verify
+    expect(that % 32 == first.size());
+    expect(that % 32 == second.size());
+    expect(exhausted.empty());
+    expect(that % 1 == pool.available());
+    expect(pool.acquire().data() == storage.data());
+    expect(throws<hal::argument_out_of_domain>(
+      [&]() { can_isotp_pool small(storage, 71); }));
+  };
+
+  "can_router::add_isotp()"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<hal::byte, 32> storage{};
+    can_isotp_pool pool(storage, 16);
+    can_router router(mock);
+    std::vector<hal::byte> received{};
+    can_isotp_receiver receiver(
+      mock,
+      pool,
+      { .id = 0x7E8, .block_size = 1, .separation_time = 5 },
+      [&](std::span<const hal::byte> p_payload) {
+        received.assign(p_payload.begin(), p_payload.end());
+      });
+    auto route = router.add_isotp(0x7E0, receiver);
+
+    // Exercise
+    mock.m_handler(frame({ 0x03, 0x22, 0xF1, 0x90 }));
+
+    // Verify
+    expect(that % 3 == received.size());
+    expect(that % 0xF1 == received[1]);
+
+    // Exercise
+    mock.m_handler(frame({ 0x10, 14, 1, 2, 3, 4, 5, 6 }));
+
+    // Verify
+    expect(that % 1 == mock.m_sent.size());
+    expect(that % 0x7E8 == mock.m_sent[0].id);
+    expect(that % 0x30 == mock.m_sent[0].payload[0]);
+    expect(that % 1 == mock.m_sent[0].payload[1]);
+    expect(that % 5 == mock.m_sent[0].payload[2]);
+    expect(that % 1 == pool.available());
+
+    // Exercise
+    mock.m_handler(frame({ 0x21, 7, 8, 9, 10, 11, 12, 13 }));
+    mock.m_handler(frame({ 0x22, 14, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC }));
+
+    // Verify
+    expect(that % 2 == mock.m_sent.size());
+    expect(that % 14 == received.size());
+    expect(that % 1 == received[0]);
+    expect(that % 14 == received[13]);
+    expect(that % 2 == receiver.completed_count());
+    expect(that % 2 == pool.available());
+
+    // Exercise
+    mock.m_handler(frame({ 0x10, 20, 1, 2, 3, 4, 5, 6 }));
+
+    // Verify
+    expect(that % 0x32 == mock.m_sent.back().payload[0]);
+    expect(that % 1 == receiver.aborted_count());
+
+    // Exercise
+    mock.m_handler(frame({ 0x10, 14, 1, 2, 3, 4, 5, 6 }));
+    mock.m_handler(frame({ 0x23, 7, 8, 9, 10, 11, 12, 13 }));
+
+    // Verify
+    expect(that % 2 == receiver.aborted_count());
+    expect(that % 2 == pool.available());
+  };
+
+  "can_isotp_receiver::operator() throwing handler"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<hal::byte, 16> storage{};
+    can_isotp_pool pool(storage, 16);
+    can_isotp_receiver receiver(
+      mock,
+      pool,
+      { .id = 0x7E8 },
+      [](std::span<const hal::byte>) {
+        hal::safe_throw(hal::resource_unavailable_try_again(nullptr));
+      });
+
+    // Exercise
+    receiver(frame({ 0x10, 8, 1, 2, 3, 4, 5, 6 }));
+
+    // Verify
+    expect(that % 0 == pool.available());
+    expect(throws<hal::resource_unavailable_try_again>(
+      [&]() { receiver(frame({ 0x21, 7, 8 })); }));
+    expect(that % 1 == receiver.completed_count());
+    expect(that % 1 == pool.available());
+  };
+};
+}  // namespace hal
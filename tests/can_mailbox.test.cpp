@@ -0,0 +1,106 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-canrouter/can_mailbox.hpp>
+
+#include <array>
+#include <functional>
+
+#include <libhal-canrouter/can_router.hpp>
+#include <libhal/error.hpp>
+#include <libhal/functional.hpp>
+
+#include <boost/ut.hpp>
+
+#include "helpers.hpp"
+
+namespace hal {
+void can_mailbox_test()
+{
+  using namespace boost::ut;
+
+  "can_mailbox::read()"_test = []() {
+    // Setup
+    mock_steady_clock clock;
+    can_mailbox mailbox(clock);
+
+    // Exercise & Verify
+    expect(not mailbox.read().has_value());
+    expect(that % 0 == mailbox.sequence());
+
+    // Exercise
+    clock.m_uptime = 500;
+    mailbox(can::message_t{ .id = 0x111, .payload = { 0xAA }, .length = 1 });
+    clock.m_uptime = 750;
+    mailbox(can::message_t{ .id = 0x111, .payload = { 0xBB }, .length = 1 });
+    auto const snapshot = mailbox.read();
+
+    // Verify
+    expect(snapshot.has_value());
+    expect(that % 0x111 == snapshot->message.id);
+    expect(that % 0xBB == snapshot->message.payload[0]);
+    expect(that % 750 == snapshot->timestamp);
+    expect(that % 2 == snapshot->sequence);
+    expect(that % 2 == mailbox.sequence());
+  };
+
+  "can_router::add_mailbox()"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can::message_t, 2> queue_storage{};
+    can_message_queue queue(queue_storage);
+    can_router router(mock);
+    can_mailbox mailbox;
+    router.defer_dispatch(&queue);
+    auto battery = router.add_mailbox(0x2F0, mailbox);
+
+    // Exercise
+    mock.m_handler(can::message_t{ .id = 0x2F0, .payload = { 12 } });
+    mock.m_handler(can::message_t{ .id = 0x2F1, .payload = { 13 } });
+
+    // Verify
+    auto const snapshot = mailbox.read();
+    expect(snapshot.has_value());
+    expect(that % 12 == snapshot->message.payload[0]);
+    expect(that % 0 == snapshot->timestamp);
+    expect(that % 1 == snapshot->sequence);
+    expect(that % 0 == queue.size());
+  };
+
+  "can_router::add_thin_route() mailbox"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can::message_t, 2> queue_storage{};
+    can_message_queue queue(queue_storage);
+    can_router router(mock);
+    can_mailbox mailbox;
+    router.defer_dispatch(&queue);
+    auto battery = router.add_thin_route(
+      { .id = 0x2F0,
+        .handler = std::ref(mailbox),
+        .dispatch = can_router::dispatch_mode::immediate });
+
+    // Exercise
+    mock.m_handler(can::message_t{ .id = 0x2F0, .payload = { 12 } });
+    mock.m_handler(can::message_t{ .id = 0x2F1, .payload = { 13 } });
+
+    // Verify
+    auto const snapshot = mailbox.read();
+    expect(snapshot.has_value());
+    expect(that % 12 == snapshot->message.payload[0]);
+    expect(that % 1 == snapshot->sequence);
+    expect(that % 0 == queue.size());
+  };
+};
+}  // namespace hal
@@ -0,0 +1,83 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-canrouter/can_message_queue.hpp>
+
+#include <array>
+
+#include <libhal-util/can.hpp>
+#include <libhal/error.hpp>
+
+#include <boost/ut.hpp>
+
+namespace hal {
+void can_message_queue_test()
+{
+  using namespace boost::ut;
+
+  "can_message_queue::can_message_queue() empty storage"_test = []() {
+    expect(throws<hal::argument_out_of_domain>(
+      []() { can_message_queue queue(std::span<can::message_t>{}); }));
+  };
+
+  "can_message_queue::push() & pop()"_test = []() {
+    // Setup
+    std::array<can::message_t, 3> storage{};
+    can_message_queue queue(storage);
+
+    // Exercise & Verify
+    expect(that % 3 == queue.capacity());
+    expect(that % 0 == queue.size());
+    expect(not queue.pop().has_value());
+
+    // Wrap around the storage several times
+    for (can::id_t id = 0; id < 10; id++) {
+      expect(queue.push(can::message_t{ .id = id }));
+      expect(queue.push(can::message_t{ .id = id + 100 }));
+      expect(that % 2 == queue.size());
+
+      auto const first = queue.pop();
+      auto const second = queue.pop();
+      expect(first.has_value() && first->id == id);
+      expect(second.has_value() && second->id == id + 100);
+    }
+
+    expect(that % 0 == queue.size());
+    expect(that % 2 == queue.high_water_mark());
+    expect(that % 0 == queue.overflow_count());
+  };
+
+  "can_message_queue::push() full"_test = []() {
+    // Setup
+    std::array<can::message_t, 2> storage{};
+    can_message_queue queue(storage);
+    expect(queue.push(can::message_t{ .id = 1 }));
+    expect(queue.pop().has_value());
+
+    // Exercise
+    expect(queue.push(can::message_t{ .id = 2 }));
+    expect(queue.push(can::message_t{ .id = 3 }));
+    expect(not queue.push(can::message_t{ .id = 4 }));
+    expect(not queue.push(can::message_t{ .id = 5 }));
+
+    // Verify
+    expect(that % 2 == queue.size());
+    expect(that % 2 == queue.high_water_mark());
+    expect(that % 2 == queue.overflow_count());
+    expect(that % 2 == queue.pop()->id);
+    expect(that % 3 == queue.pop()->id);
+    expect(not queue.pop().has_value());
+  };
+};
+}  // namespace hal
@@ -0,0 +1,101 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-canrouter/can_mux.hpp>
+
+#include <array>
+#include <functional>
+
+#include <libhal-canrouter/can_router.hpp>
+#include <libhal/error.hpp>
+#include <libhal/functional.hpp>
+
+#include <boost/ut.hpp>
+
+#include "helpers.hpp"
+
+namespace hal {
+void can_mux_test()
+{
+  using namespace boost::ut;
+
+  "can_mux::can_mux() invalid selector"_test = []() {
+    std::array<can_mux::message_handler, 16> table{};
+    expect(throws<hal::argument_out_of_domain>(
+      [&]() { can_mux mux(table, { .width = 8 }); }));
+    expect(throws<hal::argument_out_of_domain>(
+      [&]() { can_mux mux(table, { .shift = 6, .width = 4 }); }));
+    expect(throws<hal::argument_out_of_domain>(
+      [&]() { can_mux mux(table, { .byte = 8, .width = 4 }); }));
+  };
+
+  "can_mux::operator()"_test = []() {
+    // Setup
+    mock_can mock;
+    can_router router(mock);
+    std::array<can_mux::message_handler, 16> table{};
+    can_mux mux(table, { .byte = 1, .shift = 4, .width = 4 });
+    std::array<int, 2> counter{};
+    mux.set(0x3, [&](const can::message_t&) { counter[0]++; });
+    mux.set(0xA, [&](const can::message_t&) { counter[1]++; });
+    auto route = router.add_message_callback(0x400, std::ref(mux));
+
+    // Exercise
+    mock.m_handler(
+      can::message_t{ .id = 0x400, .payload = { 0, 0x31 }, .length = 2 });
+    mock.m_handler(
+      can::message_t{ .id = 0x400, .payload = { 0, 0xA0 }, .length = 2 });
+    mock.m_handler(
+      can::message_t{ .id = 0x400, .payload = { 0, 0xA0 }, .length = 1 });
+    mux.clear(0x3);
+    mock.m_handler(
+      can::message_t{ .id = 0x400, .payload = { 0, 0x30 }, .length = 2 });
+
+    // Verify
+    expect(that % 1 == counter[0]);
+    expect(that % 1 == counter[1]);
+    expect(that % 2 == mux.unselected_count());
+    expect(throws<hal::argument_out_of_domain>(
+      [&]() { mux.set(16, [](const can::message_t&) {}); }));
+  };
+
+  "can_mux::operator() behind a thin route"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can_router::index_entry, 2> index_storage{};
+    can_router router(mock, index_storage);
+    std::array<can_mux::message_handler, 4> table{};
+    can_mux mux(table, { .byte = 0, .shift = 0, .width = 2 });
+    std::array<int, 2> counter{};
+    mux.set(1, [&](const can::message_t&) { counter[0]++; });
+    mux.set(2, [&](const can::message_t&) { counter[1]++; });
+    auto route =
+      router.add_thin_route({ .id = 0x400, .handler = std::ref(mux) });
+
+    // Exercise
+    mock.m_handler(
+      can::message_t{ .id = 0x400, .payload = { 1 }, .length = 1 });
+    mock.m_handler(
+      can::message_t{ .id = 0x400, .payload = { 2 }, .length = 1 });
+    mock.m_handler(
+      can::message_t{ .id = 0x400, .payload = { 3 }, .length = 1 });
+
+    // Verify
+    expect(that % 1 == counter[0]);
+    expect(that % 1 == counter[1]);
+    expect(that % 1 == mux.unselected_count());
+    expect(that % 1 == router.thin_handlers().size());
+  };
+};
+}  // namespace hal
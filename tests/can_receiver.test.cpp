@@ -0,0 +1,337 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-canrouter/can_receiver.hpp>
+
+#include <array>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+#include <libhal-canrouter/can_router.hpp>
+#include <libhal/error.hpp>
+#include <libhal/functional.hpp>
+
+#include <boost/ut.hpp>
+
+#include "helpers.hpp"
+
+namespace hal {
+namespace {
+/// Coroutine that starts eagerly and frees its frame when it finishes
+struct detached_task
+{
+  struct promise_type
+  {
+    detached_task get_return_object()
+    {
+      return {};
+    }
+
+    std::suspend_never initial_suspend() noexcept
+    {
+      return {};
+    }
+
+    std::suspend_never final_suspend() noexcept
+    {
+      return {};
+    }
+
+    void return_void()
+    {
+    }
+
+    void unhandled_exception()
+    {
+      std::terminate();
+    }
+  };
+};
+
+/// Coroutine that starts eagerly and whose frame is freed by its owner
+class owned_task
+{
+public:
+  struct promise_type
+  {
+    owned_task get_return_object()
+    {
+      return owned_task(
+        std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+
+    std::suspend_never initial_suspend() noexcept
+    {
+      return {};
+    }
+
+    std::suspend_always final_suspend() noexcept
+    {
+      return {};
+    }
+
+    void return_void()
+    {
+    }
+
+    void unhandled_exception()
+    {
+      std::terminate();
+    }
+  };
+
+  owned_task(owned_task&& p_other) noexcept
+    : m_handle(std::exchange(p_other.m_handle, {}))
+  {
+  }
+
+  owned_task& operator=(owned_task&& p_other) = delete;
+
+  ~owned_task()
+  {
+    if (m_handle) {
+      m_handle.destroy();
+    }
+  }
+
+private:
+  explicit owned_task(std::coroutine_handle<promise_type> p_handle)
+    : m_handle(p_handle)
+  {
+  }
+
+  std::coroutine_handle<promise_type> m_handle;
+};
+
+owned_task wait_once(can_receiver& p_receiver, int& p_resumed)
+{
+  co_await p_receiver.next();
+  p_resumed++;
+}
+
+detached_task retry(can_receiver& p_receiver, int p_count, int& p_timeouts)
+{
+  for (int i = 0; i < p_count; i++) {
+    if (not co_await p_receiver.next()) {
+      p_timeouts++;
+    }
+  }
+}
+
+detached_task collect(can_receiver& p_receiver,
+                      int p_count,
+                      std::array<std::optional<can::message_t>, 3>& p_results,
+                      int& p_resumed)
+{
+  for (int i = 0; i < p_count; i++) {
+    p_results[i] = co_await p_receiver.next();
+    p_resumed++;
+  }
+}
+}  // namespace
+
+void can_receiver_test()
+{
+  using namespace boost::ut;
+
+  "can_receiver::next()"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can::message_t, 4> queue_storage{};
+    can_message_queue queue(queue_storage);
+    can_router router(mock);
+    can_receiver receiver;
+    std::array<std::optional<can::message_t>, 3> first{};
+    std::array<std::optional<can::message_t>, 3> second{};
+    int resumed = 0;
+    router.defer_dispatch(&queue);
+    auto response = router.add_message_callback(0x7E8, std::ref(receiver));
+    collect(receiver, 2, first, resumed);
+    collect(receiver, 1, second, resumed);
+
+    // Exercise
+    mock.m_handler(can::message_t{ .id = 0x7E8, .payload = { 0x41 } });
+    mock.m_handler(can::message_t{ .id = 0x7E9, .payload = { 0x42 } });
+
+    // Verify
+    expect(that % 0 == resumed);
+    expect(receiver.waiting());
+
+    // Exercise
+    router.poll();
+
+    // Verify
+    expect(first[0].has_value());
+    expect(second[0].has_value());
+    expect(that % 0x41 == first[0]->payload[0]);
+    expect(that % 0x41 == second[0]->payload[0]);
+    expect(that % 2 == resumed);
+    expect(receiver.waiting());
+
+    // Exercise
+    mock.m_handler(can::message_t{ .id = 0x7E8, .payload = { 0x43 } });
+    router.poll();
+
+    // Verify
+    expect(first[1].has_value());
+    expect(that % 0x43 == first[1]->payload[0]);
+    expect(that % 3 == resumed);
+    expect(not receiver.waiting());
+  };
+
+  "can_receiver::next() timeout"_test = []() {
+    // Setup
+    mock_can mock;
+    can_router router(mock);
+    std::array<can_timeout*, 4> slots{};
+    can_timeout_wheel wheel(slots);
+    can_receiver receiver(wheel, 3);
+    std::array<std::optional<can::message_t>, 3> results{};
+    int resumed = 0;
+    auto response = router.add_message_callback(0x7E8, std::ref(receiver));
+    collect(receiver, 3, results, resumed);
+
+    // Exercise
+    wheel.tick();
+    mock.m_handler(can::message_t{ .id = 0x7E8, .payload = { 0x41 } });
+    for (int i = 0; i < 2; i++) {
+      wheel.tick();
+    }
+
+    // Verify
+    expect(results[0].has_value());
+    expect(that % 1 == resumed);
+
+    // Exercise
+    wheel.tick();
+
+    // Verify
+    expect(not results[1].has_value());
+    expect(that % 2 == resumed);
+    expect(receiver.waiting());
+
+    // Exercise
+    receiver.cancel();
+
+    // Verify
+    expect(not results[2].has_value());
+    expect(that % 3 == resumed);
+    expect(not receiver.waiting());
+  };
+
+  "can_receiver::next() retry after timeout"_test = []() {
+    // Setup
+    std::array<can_timeout*, 8> slots{};
+    can_timeout_wheel wheel(slots);
+    int timeouts = 0;
+    can_receiver receiver(wheel, 4);
+    retry(receiver, 10, timeouts);
+
+    // Exercise
+    for (int i = 0; i < 20; i++) {
+      wheel.tick();
+    }
+
+    // Verify
+    expect(that % 5 == timeouts);
+    expect(receiver.waiting());
+
+    // Exercise
+    for (int i = 0; i < 20; i++) {
+      wheel.tick();
+    }
+
+    // Verify
+    expect(that % 10 == timeouts);
+    expect(not receiver.waiting());
+  };
+
+  "can_receiver::next() overlapping timeouts"_test = []() {
+    // Setup
+    std::array<can_timeout*, 8> slots{};
+    can_timeout_wheel wheel(slots);
+    can_receiver receiver(wheel, 4);
+    std::array<std::optional<can::message_t>, 3> first{};
+    std::array<std::optional<can::message_t>, 3> second{};
+    int first_resumed = 0;
+    int second_resumed = 0;
+    collect(receiver, 1, first, first_resumed);
+    wheel.tick();
+    wheel.tick();
+    collect(receiver, 1, second, second_resumed);
+
+    // Exercise
+    wheel.tick();
+    wheel.tick();
+
+    // Verify
+    expect(that % 1 == first_resumed);
+    expect(that % 0 == second_resumed);
+    expect(receiver.waiting());
+
+    // Exercise
+    wheel.tick();
+
+    // Verify
+    expect(that % 0 == second_resumed);
+
+    // Exercise
+    wheel.tick();
+
+    // Verify
+    expect(that % 1 == second_resumed);
+    expect(not receiver.waiting());
+  };
+
+  "can_receiver::awaiter::~awaiter()"_test = []() {
+    // Setup
+    std::array<can_timeout*, 4> slots{};
+    can_timeout_wheel wheel(slots);
+    can_receiver receiver(wheel, 3);
+    int first_resumed = 0;
+    int second_resumed = 0;
+    int third_resumed = 0;
+    auto first = wait_once(receiver, first_resumed);
+    std::optional<owned_task> second;
+    second.emplace(wait_once(receiver, second_resumed));
+    auto third = wait_once(receiver, third_resumed);
+
+    // Exercise
+    second.reset();
+    receiver(can::message_t{ .id = 0x7E8 });
+
+    // Verify
+    expect(that % 1 == first_resumed);
+    expect(that % 0 == second_resumed);
+    expect(that % 1 == third_resumed);
+    expect(not receiver.waiting());
+
+    // Setup
+    std::optional<owned_task> fourth;
+    fourth.emplace(wait_once(receiver, first_resumed));
+
+    // Exercise
+    fourth.reset();
+    for (int i = 0; i < 4; i++) {
+      wheel.tick();
+    }
+
+    // Verify
+    expect(that % 1 == first_resumed);
+    expect(not receiver.waiting());
+  };
+};
+}  // namespace hal
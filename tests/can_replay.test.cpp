@@ -0,0 +1,137 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <libhal-canrouter/can_replay.hpp>
+
+#include <array>
+#include <vector>
+
+#include <libhal-canrouter/can_router.hpp>
+#include <libhal/error.hpp>
+#include <libhal/functional.hpp>
+
+#include <boost/ut.hpp>
+
+#include "helpers.hpp"
+
+namespace hal {
+void can_replay_test()
+{
+  using namespace boost::ut;
+
+  "parse_candump()"_test = []() {
+    // Exercise
+    auto const data = parse_candump("(1436509052.249713) can1 123#DE.AD.BE\n");
+    auto const extended = parse_candump("(12.5) vcan0 1ABCDEF0#0102");
+    auto const remote = parse_candump("(0.000001) can0 7DF#R3");
+
+    // Verify
+    expect(data.has_value());
+    expect(that % 0x123 == data->id);
+    expect(that % 3 == data->length);
+    expect(that % 0xAD == data->payload[1]);
+    expect(that % 1 == data->bus);
+    expect(that % static_cast<std::uint32_t>(1436509052'249713ULL) ==
+           data->timestamp);
+    expect(extended.has_value());
+    expect(that % 0x1ABC'DEF0 == extended->id);
+    expect(that % 2 == extended->length);
+    expect(that % 12'500'000 == extended->timestamp);
+    expect(remote.has_value());
+    expect(remote->is_remote_request);
+    expect(that % 3 == remote->length);
+    expect(not parse_candump("").has_value());
+    expect(not parse_candump("can0 123#00").has_value());
+    expect(not parse_candump("(1.0) can0 123").has_value());
+    expect(not parse_candump("(1.0) can0 123#0").has_value());
+    expect(not parse_candump("(1.0) can0 123#001122334455667788").has_value());
+    expect(not parse_candump("(1.0) can0 123##0112233").has_value());
+  };
+
+  "can_replay::play() paced"_test = []() {
+    // Setup
+    mock_can mock;
+    mock_steady_clock clock;
+    clock.m_step = 1;
+    can_router router(mock);
+    std::vector<std::uint64_t> received_at;
+    auto status =
+      router.add_message_callback(0x123, [&](const can::message_t&) {
+        received_at.push_back(clock.m_last_read);
+      });
+    can_replay original(router, clock);
+    can_replay doubled(router, clock, 2.0f);
+    std::array const records{
+      can_capture::record{ .timestamp = 0xFFFF'FFF0, .id = 0x123 },
+      can_capture::record{ .timestamp = 0x0000'0010, .id = 0x123 },
+      can_capture::record{ .timestamp = 0x0000'0020, .id = 0x123, .bus = 1 },
+    };
+
+    // Exercise
+    auto const delivered = original.play(records, 1.0_MHz);
+
+    // Verify
+    expect(that % 2 == delivered);
+    expect(that % 1 == original.skipped_count());
+    expect(that % 2 == received_at.size());
+    expect(that % 0x20 == received_at[1] - received_at[0]);
+
+    // Exercise
+    received_at.clear();
+    auto const frames = doubled.play("(1.000) can0 123#01\n"
+                                     "not a frame\n"
+                                     "(1.000100) can0 123#02");
+
+    // Verify
+    expect(that % 2 == frames);
+    expect(that % 2 == received_at.size());
+    expect(that % 50 == received_at[1] - received_at[0]);
+    expect(throws<hal::argument_out_of_domain>(
+      [&]() { can_replay replay(router, clock, 0.0f); }));
+  };
+
+  "can_replay::play() capture"_test = []() {
+    // Setup
+    mock_can source_bus;
+    mock_can target_bus;
+    mock_steady_clock clock;
+    clock.m_step = 1;
+    std::array<can_capture::record, 4> storage{};
+    can_capture capture(clock, storage);
+    can_router source(source_bus);
+    can_router target(target_bus);
+    std::vector<can::message_t> received;
+    auto any = target.add_message_callback(
+      can_router::id_mask{ .value = 0, .mask = 0 },
+      [&](const can::message_t& p_message) { received.push_back(p_message); });
+    can_replay replay(target);
+    std::array<can_capture::record, 4> drained{};
+    source.capture(&capture);
+
+    // Exercise
+    source_bus.m_handler(
+      can::message_t{ .id = 0x10, .payload = { 1 }, .length = 1 });
+    source_bus.m_handler(
+      can::message_t{ .id = 0x20, .payload = { 2 }, .length = 1 });
+    auto const count = capture.read(drained);
+    auto const delivered =
+      replay.play(std::span(drained).first(count), capture.frequency());
+
+    // Verify
+    expect(that % 2 == delivered);
+    expect(that % 2 == received.size());
+    expect(that % 0x10 == received[0].id);
+    expect(that % 2 == received[1].payload[0]);
+  };
+};
+}  // namespace hal
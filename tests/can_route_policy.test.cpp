@@ -0,0 +1,171 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-canrouter/can_route_policy.hpp>
+
+#include <array>
+
+#include <libhal-canrouter/can_message_queue.hpp>
+#include <libhal-canrouter/can_router.hpp>
+#include <libhal/functional.hpp>
+
+#include <boost/ut.hpp>
+
+#include "helpers.hpp"
+
+namespace hal {
+void can_route_policy_test()
+{
+  using namespace boost::ut;
+
+  "can_route_policy::admit()"_test = []() {
+    // Setup
+    mock_steady_clock clock;
+    can_route_policy decimated;
+    can_route_policy deduplicated;
+    can_route_policy limited;
+    decimated.decimate(3);
+    deduplicated.only_on_change(true);
+    limited.limit_rate(&clock, std::chrono::milliseconds(1), 2);
+    can::message_t const first{ .id = 0x10, .payload = { 1 }, .length = 1 };
+    can::message_t const second{ .id = 0x10, .payload = { 2 }, .length = 1 };
+    int decimated_runs = 0;
+    int deduplicated_runs = 0;
+    int limited_runs = 0;
+
+    // Exercise
+    for (int i = 0; i < 7; i++) {
+      decimated_runs += decimated.admit(first);
+    }
+    deduplicated_runs += deduplicated.admit(first);
+    deduplicated_runs += deduplicated.admit(first);
+    deduplicated_runs += deduplicated.admit(second);
+    deduplicated_runs += deduplicated.admit(second);
+    deduplicated_runs += deduplicated.admit(first);
+    for (int i = 0; i < 5; i++) {
+      limited_runs += limited.admit(first);
+    }
+    clock.m_uptime = 1'000;
+    limited_runs += limited.admit(first);
+
+    // Verify
+    expect(that % 3 == decimated_runs);
+    expect(that % 4 == decimated.suppressed().decimated);
+    expect(that % 3 == deduplicated_runs);
+    expect(that % 2 == deduplicated.suppressed().unchanged);
+    expect(that % 3 == limited_runs);
+    expect(that % 3 == limited.suppressed().rate_limited);
+
+    // Exercise
+    limited.reset_suppressed();
+
+    // Verify
+    expect(that % 0 == limited.suppressed().rate_limited);
+  };
+
+  "can_route_policy::only_on_change() refresh"_test = []() {
+    // Setup
+    can_route_policy policy;
+    policy.only_on_change(true, 3);
+    can::message_t const status{ .id = 0x10, .payload = { 1, 2 }, .length = 1 };
+    can::message_t const stale{ .id = 0x10, .payload = { 1, 9 }, .length = 1 };
+    can::message_t const longer{ .id = 0x10, .payload = { 1, 9 }, .length = 2 };
+    int runs = 0;
+
+    // Exercise
+    for (int i = 0; i < 7; i++) {
+      runs += policy.admit(i % 2 == 0 ? status : stale);
+    }
+
+    // Verify
+    expect(that % 3 == runs);
+    expect(that % 4 == policy.suppressed().unchanged);
+
+    // Exercise
+    runs += policy.admit(longer);
+    runs += policy.admit(longer);
+
+    // Verify
+    expect(that % 4 == runs);
+    expect(that % 5 == policy.suppressed().unchanged);
+  };
+
+  "can_router::route::policy"_test = []() {
+    // Setup
+    mock_can mock;
+    can_router router(mock);
+    can_route_policy policy;
+    policy.only_on_change(true);
+    int counter = 0;
+    auto route = router.add_route({
+      .id = 0x321,
+      .handler = [&](const can::message_t&) { counter++; },
+      .policy = &policy,
+    });
+
+    // Exercise
+    can::message_t const status{ .id = 0x321, .payload = { 5 }, .length = 1 };
+    mock.m_handler(status);
+    mock.m_handler(status);
+    mock.m_handler(status);
+
+    // Verify
+    expect(that % 1 == counter);
+    expect(that % 2 == policy.suppressed().unchanged);
+    expect(that % 0 == router.unrouted_count());
+  };
+
+  "can_router::route::policy deferred"_test = []() {
+    // Setup
+    mock_can mock;
+    can_router router(mock);
+    std::array<can::message_t, 2> queue_storage{};
+    can_message_queue queue(queue_storage);
+    can_route_policy policy;
+    policy.decimate(4);
+    std::array<can::id_t, 4> received{};
+    std::size_t received_count = 0;
+    auto const record = [&](const can::message_t& p_message) {
+      received[received_count++] = p_message.id;
+    };
+    auto flood = router.add_route({
+      .id = 0x100,
+      .handler = record,
+      .policy = &policy,
+    });
+    auto status = router.add_route({ .id = 0x200, .handler = record });
+    router.defer_dispatch(&queue);
+
+    // Exercise
+    for (int i = 0; i < 4; i++) {
+      mock.m_handler(can::message_t{ .id = 0x100 });
+    }
+    mock.m_handler(can::message_t{ .id = 0x200 });
+
+    // Verify
+    expect(that % 2 == queue.size());
+    expect(that % 0 == queue.overflow_count());
+    expect(that % 3 == policy.suppressed().decimated);
+
+    // Exercise
+    expect(that % 2 == router.poll());
+
+    // Verify
+    expect(that % 2 == received_count);
+    expect(that % 0x100 == received[0]);
+    expect(that % 0x200 == received[1]);
+    expect(that % 3 == policy.suppressed().decimated);
+  };
+};
+}  // namespace hal
@@ -15,6 +15,8 @@
 #include <libhal-canrouter/can_router.hpp>
 
 #include <algorithm>
+#include <array>
+#include <optional>
 
 #include <libhal-util/can.hpp>
 #include <libhal/error.hpp>
@@ -22,45 +24,12 @@
 
 #include <boost/ut.hpp>
 
+#include "helpers.hpp"
+
 namespace hal {
 namespace {
-class mock_can : public hal::can
-{
-public:
-  settings m_settings{};
-  message_t m_message{};
-  std::function<handler> m_handler{};
-  bool m_return_error_status{ false };
-  size_t m_on_receive_call_count = 0;
-  bool m_noop_set = false;
-
-private:
-  void driver_configure(const settings& p_settings) override
-  {
-    m_settings = p_settings;
-    if (m_return_error_status) {
-      return hal::safe_throw(hal::operation_not_supported(this));
-    }
-  };
-
-  void driver_bus_on() override
-  {
-  }
-
-  void driver_send(const message_t& p_message) override
-  {
-    m_message = p_message;
-    if (m_return_error_status) {
-      return hal::safe_throw(hal::unknown(this));
-    }
-  };
-
-  void driver_on_receive(hal::callback<handler> p_handler) override
-  {
-    m_on_receive_call_count++;
-    m_handler = p_handler;
-  };
-};
+#if LIBHAL_CANROUTER_INSTRUMENTATION
+#endif
 }  // namespace
 
 void can_router_test()
@@ -372,5 +341,1171 @@ void can_router_test()
     expect(that % 1 == counter3);
     expect(expected3 == actual3);
   };
+
+  "can_router::operator() indexed"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can_router::index_entry, 4> index_storage{};
+    can_router router(mock, index_storage);
+    int counter1 = 0;
+    int counter2 = 0;
+    int counter3 = 0;
+    static constexpr can::message_t expected1{
+      .id = 0x300,
+      .payload = { 0xAA, 0xBB },
+      .length = 2,
+    };
+    static constexpr can::message_t expected2{
+      .id = 0x120,
+      .payload = { 0xCC, 0xDD },
+      .length = 2,
+    };
+    static constexpr can::message_t expected3{
+      .id = 0x1FF,
+      .payload = { 0xEE, 0xFF },
+      .length = 2,
+    };
+
+    auto message_handler1 = router.add_message_callback(
+      expected1.id,
+      [&counter1]([[maybe_unused]] const can::message_t& p_message) {
+        counter1++;
+      });
+    auto message_handler2 = router.add_message_callback(
+      expected2.id,
+      [&counter2]([[maybe_unused]] const can::message_t& p_message) {
+        counter2++;
+      });
+    auto message_handler3 = router.add_message_callback(
+      expected3.id,
+      [&counter3]([[maybe_unused]] const can::message_t& p_message) {
+        counter3++;
+      });
+
+    // Verify
+    expect(that % 3 == router.handlers().size());
+    expect(that % 3 == router.index().size());
+    expect(std::is_sorted(router.index().begin(),
+                          router.index().end(),
+                          [](const auto& p_left, const auto& p_right) {
+                            return p_left.id < p_right.id;
+                          }));
+
+    // Exercise
+    router(expected1);
+    router(expected2);
+    router(expected2);
+    router(can::message_t{ .id = 0x555 });
+
+    // Verify
+    expect(that % 1 == counter1);
+    expect(that % 2 == counter2);
+    expect(that % 0 == counter3);
+  };
+
+  "can_router::route_item lifetime indexed"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can_router::index_entry, 2> index_storage{};
+    can_router router(mock, index_storage);
+    int counter = 0;
+    static constexpr can::message_t expected{ .id = 0x111 };
+
+    {
+      auto item = router.add_message_callback(
+        expected.id,
+        [&counter]([[maybe_unused]] const can::message_t& p_message) {
+          counter++;
+        });
+      auto moved_item = std::move(item);
+
+      // Exercise
+      router(expected);
+
+      // Verify
+      expect(that % 1 == counter);
+      expect(that % 1 == router.index().size());
+      expect(&moved_item.get() == router.index()[0].target);
+    }
+
+    // Exercise
+    router(expected);
+
+    // Verify
+    expect(that % 1 == counter);
+    expect(that % 0 == router.index().size());
+    expect(that % 0 == router.handlers().size());
+  };
+
+  "can_router::add_message_callback() index full"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can_router::index_entry, 1> index_storage{};
+    can_router router(mock, index_storage);
+    auto item = router.add_message_callback(0x100);
+
+    // Exercise & Verify
+    expect(throws<hal::resource_unavailable_try_again>(
+      [&router]() { auto extra = router.add_message_callback(0x101); }));
+    expect(that % 1 == router.index().size());
+    expect(that % 1 == router.handlers().size());
+  };
+
+  "can_router::can_router(&&) indexed"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can_router::index_entry, 2> index_storage{};
+    can_router original_router(mock, index_storage);
+    int counter = 0;
+    static constexpr can::message_t expected{ .id = 0x111 };
+    auto item = original_router.add_message_callback(
+      expected.id,
+      [&counter]([[maybe_unused]] const can::message_t& p_message) {
+        counter++;
+      });
+
+    // Exercise
+    auto router = std::move(original_router);
+    mock.m_handler(expected);
+
+    // Verify
+    expect(that % 1 == counter);
+    expect(that % 1 == router.index().size());
+  };
+
+  "can_router::add_thin_route()"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can_router::index_entry, 4> index_storage{};
+    std::array<can_router::index_entry, 4> table_index_storage{};
+    can_router::standard_id_table standard_table{};
+    can_router linear_router(mock);
+    can_router indexed_router(mock, index_storage);
+    can_router table_router(mock, table_index_storage, standard_table);
+    std::array<int, 3> thin_counts{};
+    int callback_count = 0;
+    auto const count_thin = [](void* p_count, const can::message_t&) {
+      (*static_cast<int*>(p_count))++;
+    };
+    std::array<std::optional<can_router::thin_route_item>, 3> thin_items{};
+    std::array<std::optional<can_router::route_item>, 3> items{};
+    std::array<can_router*, 3> routers{ &linear_router,
+                                        &indexed_router,
+                                        &table_router };
+
+    for (std::size_t i = 0; i < routers.size(); i++) {
+      thin_items[i] = routers[i]->add_thin_route(
+        { .id = 0x100,
+          .handler = can_handler_ref(count_thin, &thin_counts[i]),
+          .range = 0xFF });
+      items[i] = routers[i]->add_message_callback(
+        0x123, [&callback_count](const can::message_t&) { callback_count++; });
+    }
+
+    // Exercise
+    for (auto* router : routers) {
+      (*router)(can::message_t{ .id = 0x123 });
+      (*router)(can::message_t{ .id = 0x1FF });
+      (*router)(can::message_t{ .id = 0x200 });
+    }
+
+    // Verify
+    for (std::size_t i = 0; i < routers.size(); i++) {
+      expect(that % 2 == thin_counts[i]) << i;
+      expect(that % 1 == routers[i]->thin_handlers().size()) << i;
+      expect(that % 1 == routers[i]->handlers().size()) << i;
+      expect(that % 1 == routers[i]->unrouted_count()) << i;
+    }
+    expect(that % 3 == callback_count);
+    expect(that % 1 == indexed_router.index().size());
+    expect(not indexed_router.index()[0].thin);
+    expect(&items[1]->get() == indexed_router.index()[0].target);
+  };
+
+  "can_router::thin_route_item lifetime indexed"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can_router::index_entry, 2> index_storage{};
+    can_router router(mock, index_storage);
+    int counter = 0;
+    int callback_counter = 0;
+    static constexpr can::message_t expected{ .id = 0x111 };
+    auto callback_item = router.add_message_callback(
+      expected.id,
+      [&callback_counter]([[maybe_unused]] const can::message_t& p_message) {
+        callback_counter++;
+      });
+
+    {
+      auto item = router.add_thin_route(
+        { .id = expected.id,
+          .handler = can_handler_ref(
+            [](void* p_context, const can::message_t&) {
+              (*static_cast<int*>(p_context))++;
+            },
+            &counter) });
+      auto moved_item = std::move(item);
+
+      // Exercise
+      router(expected);
+
+      // Verify
+      expect(that % 1 == counter);
+      expect(that % 1 == callback_counter);
+      expect(that % 2 == router.index().size());
+      expect(std::any_of(
+        router.index().begin(), router.index().end(), [&](const auto& p_entry) {
+          return p_entry.thin && p_entry.target == &moved_item.get() &&
+                 p_entry.owner == &moved_item;
+        }));
+    }
+
+    // Exercise
+    router(expected);
+
+    // Verify
+    expect(that % 1 == counter);
+    expect(that % 2 == callback_counter);
+    expect(that % 1 == router.index().size());
+    expect(not router.index()[0].thin);
+    expect(that % 0 == router.thin_handlers().size());
+  };
+
+  "can_router::can_router(&&) thin routes"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can_router::index_entry, 2> index_storage{};
+    can_router original_linear_router(mock);
+    can_router original_indexed_router(mock, index_storage);
+    std::array<int, 2> counters{};
+    auto const count = [](void* p_count, const can::message_t&) {
+      (*static_cast<int*>(p_count))++;
+    };
+    static constexpr can::message_t expected{ .id = 0x111 };
+    auto linear_item = original_linear_router.add_thin_route(
+      { .id = expected.id, .handler = can_handler_ref(count, &counters[0]) });
+    auto indexed_item = original_indexed_router.add_thin_route(
+      { .id = expected.id, .handler = can_handler_ref(count, &counters[1]) });
+
+    // Exercise
+    auto linear_router = std::move(original_linear_router);
+    auto indexed_router = std::move(original_indexed_router);
+    linear_router(expected);
+    indexed_router(expected);
+    {
+      auto released = std::move(linear_item);
+    }
+    linear_router(expected);
+
+    // Verify
+    expect(that % 1 == counters[0]);
+    expect(that % 1 == counters[1]);
+    expect(that % 0 == linear_router.thin_handlers().size());
+    expect(that % 1 == indexed_router.thin_handlers().size());
+    expect(that % 1 == indexed_router.index().size());
+    expect(that % 1 == linear_router.unrouted_count());
+  };
+
+  "can_router::operator() standard id table"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can_router::index_entry, 8> index_storage{};
+    can_router::standard_id_table standard_table{};
+    can_router router(mock, index_storage, standard_table);
+    std::array<int, 4> counters{};
+    static constexpr std::array<can::id_t, 4> ids{
+      0x7FF,
+      0x000,
+      0x1234'5678,
+      0x123,
+    };
+
+    auto item0 = router.add_message_callback(
+      ids[0], [&counters](const can::message_t&) { counters[0]++; });
+    auto item2 = router.add_message_callback(
+      ids[2], [&counters](const can::message_t&) { counters[2]++; });
+    auto item3 = router.add_message_callback(
+      ids[3], [&counters](const can::message_t&) { counters[3]++; });
+
+    {
+      auto item1 = router.add_message_callback(
+        ids[1], [&counters](const can::message_t&) { counters[1]++; });
+
+      // Exercise
+      for (auto const id : ids) {
+        router(can::message_t{ .id = id });
+      }
+      router(can::message_t{ .id = 0x124 });
+      router(can::message_t{ .id = 0x800 });
+
+      // Verify
+      expect(that % 1 == counters[0]);
+      expect(that % 1 == counters[1]);
+      expect(that % 1 == counters[2]);
+      expect(that % 1 == counters[3]);
+      expect(that % 1 == standard_table[0x000]);
+    }
+
+    // Exercise: routes after the removed one have shifted within the index
+    for (auto const id : ids) {
+      router(can::message_t{ .id = id });
+    }
+
+    // Verify
+    expect(that % 2 == counters[0]);
+    expect(that % 1 == counters[1]);
+    expect(that % 2 == counters[2]);
+    expect(that % 2 == counters[3]);
+    expect(that % 0 == standard_table[0x000]);
+    expect(that % 1 == standard_table[0x123]);
+    expect(that % 2 == standard_table[0x7FF]);
+  };
+
+  "can_router::add_message_callback(id_mask/id_range, callback)"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can_router::index_entry, 4> index_storage{};
+    can_router linear_router(mock);
+    can_router indexed_router(mock, index_storage);
+
+    for (auto* router : { &linear_router, &indexed_router }) {
+      int mask_counter = 0;
+      int range_counter = 0;
+      int exact_counter = 0;
+      auto exact_item = router->add_message_callback(
+        0x205, [&exact_counter](const can::message_t&) { exact_counter++; });
+      auto mask_item = router->add_message_callback(
+        can_router::id_mask{ .value = 0x120, .mask = 0x7F0 },
+        [&mask_counter](const can::message_t&) { mask_counter++; });
+      auto range_item = router->add_message_callback(
+        can_router::id_range{ .first = 0x200, .last = 0x20F },
+        [&range_counter](const can::message_t&) { range_counter++; });
+
+      // Exercise
+      router->operator()(can::message_t{ .id = 0x120 });
+      router->operator()(can::message_t{ .id = 0x12F });
+      router->operator()(can::message_t{ .id = 0x130 });
+      router->operator()(can::message_t{ .id = 0x1FF });
+      router->operator()(can::message_t{ .id = 0x200 });
+      router->operator()(can::message_t{ .id = 0x20F });
+      router->operator()(can::message_t{ .id = 0x210 });
+      router->operator()(can::message_t{ .id = 0x205 });
+
+      // Verify: 0x205 is delivered to both the exact and the range route
+      expect(that % 2 == mask_counter);
+      expect(that % 3 == range_counter);
+      expect(that % 1 == exact_counter);
+    }
+
+    expect(that % 0 == indexed_router.index().size());
+    expect(throws<hal::argument_out_of_domain>([&linear_router]() {
+      auto item = linear_router.add_message_callback(
+        can_router::id_range{ .first = 0x20, .last = 0x10 }, can_router::noop);
+    }));
+  };
+
+  "can_router::acceptance_filters()"_test = []() {
+    // Setup
+    mock_can mock;
+    can_router router(mock);
+    auto exact1 = router.add_message_callback(0x100);
+    auto exact2 = router.add_message_callback(0x101);
+    auto exact3 = router.add_message_callback(0x7FF);
+    auto range = router.add_message_callback(
+      can_router::id_range{ .first = 0x300, .last = 0x3FF }, can_router::noop);
+    std::array<can_router::acceptance_filter, 8> plenty{};
+    std::array<can_router::acceptance_filter, 2> scarce{};
+    std::array<can_router::acceptance_filter, 0> none{};
+
+    // Exercise
+    auto const plenty_result = router.acceptance_filters(plenty);
+    auto const scarce_result = router.acceptance_filters(scarce);
+    auto const none_result = router.acceptance_filters(none);
+
+    // Verify
+    auto const accepts = [](std::span<can_router::acceptance_filter> p_filters,
+                            can::id_t p_id) {
+      return std::any_of(
+        p_filters.begin(), p_filters.end(), [p_id](const auto& p_filter) {
+          return (p_id & p_filter.mask) == p_filter.id;
+        });
+    };
+
+    expect(that % 4 == plenty_result.size());
+    expect(that % 2 == scarce_result.size());
+    expect(that % 0 == none_result.size());
+    for (can::id_t id = 0; id < can_router::standard_id_count; id++) {
+      auto const routed = id == 0x100 || id == 0x101 || id == 0x7FF ||
+                          (id >= 0x300 && id <= 0x3FF);
+      expect(routed == accepts(plenty_result, id)) << id;
+      if (routed) {
+        expect(accepts(scarce_result, id)) << id;
+      }
+    }
+  };
+
+  "can_router::poll() deferred dispatch"_test = []() {
+    // Setup
+    mock_can mock;
+    can_router router(mock);
+    std::array<can::message_t, 4> queue_storage{};
+    can_message_queue queue(queue_storage);
+    std::array<can::id_t, 8> received{};
+    std::size_t received_count = 0;
+    auto item = router.add_message_callback(
+      can_router::id_range{ .first = 0x100, .last = 0x1FF },
+      [&](const can::message_t& p_message) {
+        received[received_count++] = p_message.id;
+      });
+
+    // Exercise
+    expect(that % 0 == router.poll());
+    router.defer_dispatch(&queue);
+    for (can::id_t id = 0x100; id < 0x106; id++) {
+      mock.m_handler(can::message_t{ .id = id });
+    }
+
+    // Verify
+    expect(that % 0 == received_count);
+    expect(that % 4 == queue.size());
+    expect(that % 2 == queue.overflow_count());
+
+    // Exercise
+    expect(that % 3 == router.poll(3));
+    expect(that % 1 == router.poll());
+    expect(that % 0 == router.poll());
+
+    // Verify
+    expect(that % 4 == received_count);
+    expect(that % 0x100 == received[0]);
+    expect(that % 0x103 == received[3]);
+
+    // Exercise
+    router.defer_dispatch(nullptr);
+    mock.m_handler(can::message_t{ .id = 0x110 });
+
+    // Verify
+    expect(that % 5 == received_count);
+    expect(that % 0x110 == received[4]);
+  };
+
+  "can_router::operator() immediate routes while deferred"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can_router::index_entry, 2> index_storage{};
+    can_router router(mock, index_storage);
+    std::array<can::message_t, 4> queue_storage{};
+    can_message_queue queue(queue_storage);
+    int critical_counter = 0;
+    int logging_counter = 0;
+    auto critical = router.add_message_callback(
+      0x001,
+      [&critical_counter](const can::message_t&) { critical_counter++; },
+      can_router::dispatch_mode::immediate);
+    auto logging = router.add_message_callback(
+      0x700, [&logging_counter](const can::message_t&) { logging_counter++; });
+    router.defer_dispatch(&queue);
+
+    // Exercise
+    mock.m_handler(can::message_t{ .id = 0x700 });
+    mock.m_handler(can::message_t{ .id = 0x001 });
+    mock.m_handler(can::message_t{ .id = 0x123 });
+
+    // Verify
+    expect(that % 1 == critical_counter);
+    expect(that % 0 == logging_counter);
+    expect(that % 1 == queue.size());
+
+    // Exercise
+    expect(that % 1 == router.poll());
+
+    // Verify
+    expect(that % 1 == critical_counter);
+    expect(that % 1 == logging_counter);
+  };
+
+  "can_router::operator() fan out"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can_router::index_entry, 8> index_storage{};
+    std::array<can_router::index_entry, 8> table_index_storage{};
+    can_router::standard_id_table standard_table{};
+    can_router linear_router(mock);
+    can_router indexed_router(mock, index_storage);
+    can_router table_router(mock, table_index_storage, standard_table);
+
+    for (auto* router : { &linear_router, &indexed_router, &table_router }) {
+      std::array<int, 3> order{};
+      int calls = 0;
+      static constexpr can::id_t standard_id = 0x321;
+      static constexpr can::id_t extended_id = 0x1234'5678;
+
+      auto other = router->add_message_callback(0x320);
+      auto first = router->add_message_callback(
+        standard_id, [&](const can::message_t&) { order[0] = ++calls; });
+      auto second = router->add_message_callback(
+        standard_id, [&](const can::message_t&) { order[1] = ++calls; });
+      auto extended1 = router->add_message_callback(
+        extended_id, [&](const can::message_t&) { calls++; });
+      auto extended2 = router->add_message_callback(
+        extended_id, [&](const can::message_t&) { calls++; });
+      auto third = router->add_message_callback(
+        standard_id, [&](const can::message_t&) { order[2] = ++calls; });
+
+      // Exercise
+      router->operator()(can::message_t{ .id = standard_id });
+
+      // Verify
+      expect(that % 3 == calls);
+      expect(that % 1 == order[0]);
+      expect(that % 2 == order[1]);
+      expect(that % 3 == order[2]);
+
+      // Exercise
+      router->operator()(can::message_t{ .id = extended_id });
+
+      // Verify
+      expect(that % 5 == calls);
+    }
+  };
+
+  "can_router::dispatch(messages)"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can_router::index_entry, 8> index_storage{};
+    std::array<can_router::index_entry, 8> table_index_storage{};
+    can_router::standard_id_table standard_table{};
+    can_router linear_router(mock);
+    can_router indexed_router(mock, index_storage);
+    can_router table_router(mock, table_index_storage, standard_table);
+
+    for (auto* router : { &linear_router, &indexed_router, &table_router }) {
+      std::array<int, 4> counter{};
+      std::array<can::id_t, 6> received{};
+      std::size_t received_count = 0;
+      auto record = [&](const can::message_t& p_message) {
+        received[received_count++] = p_message.id;
+      };
+
+      auto sensor = router->add_message_callback(0x100, [&](auto& p_message) {
+        counter[0]++;
+        record(p_message);
+      });
+      auto sensor_log = router->add_message_callback(
+        0x100, [&](const can::message_t&) { counter[1]++; });
+      auto status = router->add_message_callback(0x1234'5678,
+                                                 [&](auto& p_message) {
+                                                   counter[2]++;
+                                                   record(p_message);
+                                                 });
+      auto any_heartbeat = router->add_message_callback(
+        can_router::id_range{ .first = 0x700, .last = 0x77F },
+        [&](auto& p_message) {
+          counter[3]++;
+          record(p_message);
+        });
+
+      std::array<can::message_t, 6> const burst{
+        can::message_t{ .id = 0x100 },      can::message_t{ .id = 0x100 },
+        can::message_t{ .id = 0x701 },      can::message_t{ .id = 0x1234'5678 },
+        can::message_t{ .id = 0x555 },      can::message_t{ .id = 0x100 },
+      };
+
+      // Exercise
+      router->dispatch(burst);
+
+      // Verify
+      expect(that % 3 == counter[0]);
+      expect(that % 3 == counter[1]);
+      expect(that % 1 == counter[2]);
+      expect(that % 1 == counter[3]);
+      expect(that % 5 == received_count);
+      expect(that % 0x100 == received[0]);
+      expect(that % 0x100 == received[1]);
+      expect(that % 0x701 == received[2]);
+      expect(that % 0x1234'5678 == received[3]);
+      expect(that % 0x100 == received[4]);
+    }
+  };
+
+  "can_router::dispatch(messages) deferred"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can::message_t, 4> queue_storage{};
+    can_message_queue queue(queue_storage);
+    std::array<can_router::index_entry, 4> index_storage{};
+    can_router router(mock, index_storage);
+    int immediate_counter = 0;
+    int deferred_counter = 0;
+    router.defer_dispatch(&queue);
+
+    auto immediate = router.add_message_callback(
+      0x100,
+      [&](const can::message_t&) { immediate_counter++; },
+      can_router::dispatch_mode::immediate);
+    auto deferred = router.add_message_callback(
+      0x100, [&](const can::message_t&) { deferred_counter++; });
+
+    std::array<can::message_t, 3> const burst{
+      can::message_t{ .id = 0x100 },
+      can::message_t{ .id = 0x100 },
+      can::message_t{ .id = 0x200 },
+    };
+
+    // Exercise
+    router.dispatch(burst);
+
+    // Verify
+    expect(that % 2 == immediate_counter);
+    expect(that % 0 == deferred_counter);
+    expect(that % 2 == queue.size());
+
+    // Exercise
+    expect(that % 2 == router.poll());
+
+    // Verify
+    expect(that % 2 == immediate_counter);
+    expect(that % 2 == deferred_counter);
+  };
+
+  "can_router::cache_hot_routes()"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can_router::index_entry, 8> index_storage{};
+    std::array<can_router::hot_route, 2> cache{};
+    can_router router(mock, index_storage);
+    std::array<int, 3> counter{};
+    router.cache_hot_routes(cache);
+
+    auto sensor = router.add_message_callback(
+      0x100, [&](const can::message_t&) { counter[0]++; });
+    std::optional<can_router::route_item> block = router.add_message_callback(
+      can_router::id_range{ .first = 0x200, .last = 0x20F },
+      [&](const can::message_t&) { counter[1]++; });
+
+    // Exercise
+    router(can::message_t{ .id = 0x100 });
+    router(can::message_t{ .id = 0x205 });
+    router(can::message_t{ .id = 0x205 });
+    router(can::message_t{ .id = 0x100 });
+
+    // Verify
+    expect(that % 2 == counter[0]);
+    expect(that % 2 == counter[1]);
+    expect(that % 0 != cache[0].generation);
+    expect(that % 0x205 == cache[0].id);
+    expect(cache[0].group.wildcards);
+    expect(that % 0 == cache[0].group.exact.size());
+
+    // Exercise
+    router(can::message_t{ .id = 0x100 });
+    router(can::message_t{ .id = 0x100 });
+
+    // Verify
+    expect(that % 4 == counter[0]);
+    expect(that % 0x100 == cache[0].id);
+    expect(not cache[0].group.wildcards);
+    expect(that % 1 == cache[0].group.exact.size());
+
+    // Exercise
+    auto const stale_generation = cache[0].generation;
+    auto sensor_log = router.add_message_callback(
+      0x100, [&](const can::message_t&) { counter[2]++; });
+    router(can::message_t{ .id = 0x100 });
+
+    // Verify
+    expect(that % stale_generation == cache[0].generation);
+    expect(that % 0x100 == cache[1].id);
+    expect(that % stale_generation != cache[1].generation);
+    expect(that % 2 == cache[1].group.exact.size());
+
+    // Exercise
+    block.reset();
+    router(can::message_t{ .id = 0x205 });
+
+    // Verify
+    expect(that % 5 == counter[0]);
+    expect(that % 2 == counter[1]);
+    expect(that % 1 == counter[2]);
+  };
+
+  "can_router::filter_unrouted()"_test = []() {
+    // Setup
+    static constexpr auto is_set = [](const can_router::id_filter& p_filter,
+                                      can::id_t p_id) {
+      return ((p_filter.standard[p_id / 32] >> (p_id % 32)) & 1U) == 1U;
+    };
+    mock_can mock;
+    std::array<can_router::index_entry, 8> index_storage{};
+    can_router linear_router(mock);
+    can_router indexed_router(mock, index_storage);
+
+    for (auto* router : { &linear_router, &indexed_router }) {
+      can_router::id_filter filter{};
+      std::array<int, 4> counter{};
+      auto sensor = router->add_message_callback(
+        0x100, [&](const can::message_t&) { counter[0]++; });
+      router->filter_unrouted(&filter);
+
+      std::optional<can_router::route_item> extended =
+        router->add_message_callback(
+          0x1234'5678, [&](const can::message_t&) { counter[1]++; });
+      auto block = router->add_message_callback(
+        can_router::id_range{ .first = 0x200, .last = 0x20F },
+        [&](const can::message_t&) { counter[2]++; });
+
+      // Exercise
+      router->operator()(can::message_t{ .id = 0x100 });
+      router->operator()(can::message_t{ .id = 0x101 });
+      router->operator()(can::message_t{ .id = 0x20F });
+      router->operator()(can::message_t{ .id = 0x210 });
+      router->operator()(can::message_t{ .id = 0x1234'5678 });
+      router->operator()(can::message_t{ .id = 0x1234'5679 });
+
+      // Verify
+      expect(that % 1 == counter[0]);
+      expect(that % 1 == counter[1]);
+      expect(that % 1 == counter[2]);
+      expect(is_set(filter, 0x100));
+      expect(not is_set(filter, 0x101));
+      expect(is_set(filter, 0x200));
+      expect(is_set(filter, 0x20F));
+      expect(not is_set(filter, 0x210));
+      expect(not filter.every_extended);
+      expect(std::any_of(filter.extended.begin(),
+                         filter.extended.end(),
+                         [](std::uint32_t p_word) { return p_word != 0; }));
+
+      // Exercise
+      auto group = router->add_message_callback(
+        can_router::id_mask{ .value = 0x0001'0000, .mask = 0x1FFF'0000 },
+        [&](const can::message_t&) { counter[3]++; });
+      router->operator()(can::message_t{ .id = 0x0001'0042 });
+
+      // Verify
+      expect(filter.every_extended);
+      expect(that % 1 == counter[3]);
+
+      router->filter_unrouted(nullptr);
+    }
+
+    // Exercise
+    can_router::id_filter filter{};
+    auto removed =
+      std::make_optional(indexed_router.add_message_callback(0x300));
+    auto kept = indexed_router.add_message_callback(0x301);
+    indexed_router.filter_unrouted(&filter);
+    removed.reset();
+
+    // Verify
+    expect(not is_set(filter, 0x300));
+    expect(is_set(filter, 0x301));
+  };
+
+  "can_router::add_thin_route() deferred and filtered"_test = []() {
+    // Setup
+    static constexpr auto is_set = [](const can_router::id_filter& p_filter,
+                                      can::id_t p_id) {
+      return ((p_filter.standard[p_id / 32] >> (p_id % 32)) & 1U) == 1U;
+    };
+    mock_can mock;
+    std::array<can_router::index_entry, 4> index_storage{};
+    can_router linear_router(mock);
+    can_router indexed_router(mock, index_storage);
+
+    for (auto* router : { &linear_router, &indexed_router }) {
+      std::array<can::message_t, 4> queue_storage{};
+      can_message_queue queue(queue_storage);
+      can_router::id_filter filter{};
+      std::array<can_router::acceptance_filter, 4> filters{};
+      std::array<int, 2> counter{};
+      auto const count = [](void* p_count, const can::message_t&) {
+        (*static_cast<int*>(p_count))++;
+      };
+      auto deferred = router->add_thin_route(
+        { .id = 0x200,
+          .handler = can_handler_ref(count, &counter[0]),
+          .range = 0x0F });
+      auto immediate = router->add_thin_route(
+        { .id = 0x300,
+          .handler = can_handler_ref(count, &counter[1]),
+          .dispatch = can_router::dispatch_mode::immediate });
+      router->filter_unrouted(&filter);
+      router->defer_dispatch(&queue);
+
+      // Exercise
+      router->operator()(can::message_t{ .id = 0x205 });
+      router->operator()(can::message_t{ .id = 0x300 });
+      router->operator()(can::message_t{ .id = 0x301 });
+
+      // Verify
+      expect(that % 0 == counter[0]);
+      expect(that % 1 == counter[1]);
+      expect(that % 1 == queue.size());
+
+      // Exercise
+      expect(that % 1 == router->poll());
+      auto const accepted = router->acceptance_filters(filters);
+
+      // Verify
+      expect(that % 1 == counter[0]);
+      expect(that % 1 == router->unrouted_count());
+      expect(is_set(filter, 0x200));
+      expect(is_set(filter, 0x20F));
+      expect(is_set(filter, 0x300));
+      expect(not is_set(filter, 0x301));
+      expect(that % 2 == accepted.size());
+      router->filter_unrouted(nullptr);
+      router->defer_dispatch(nullptr);
+    }
+  };
+
+  "can_router::on_unrouted()"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can_router::index_entry, 4> index_storage{};
+    can_router linear_router(mock);
+    can_router indexed_router(mock, index_storage);
+
+    for (auto* router : { &linear_router, &indexed_router }) {
+      int routed_counter = 0;
+      int unrouted_counter = 0;
+      can::id_t unrouted_id = 0;
+      auto routed = router->add_message_callback(
+        0x100, [&](const can::message_t&) { routed_counter++; });
+
+      // Exercise
+      router->operator()(can::message_t{ .id = 0x101 });
+
+      // Verify
+      expect(that % 1 == router->unrouted_count());
+
+      // Exercise
+      router->on_unrouted([&](const can::message_t& p_message) {
+        unrouted_counter++;
+        unrouted_id = p_message.id;
+      });
+      router->operator()(can::message_t{ .id = 0x100 });
+      router->operator()(can::message_t{ .id = 0x1234'5678 });
+
+      // Verify
+      expect(that % 1 == routed_counter);
+      expect(that % 1 == unrouted_counter);
+      expect(that % 0x1234'5678 == unrouted_id);
+      expect(that % 2 == router->unrouted_count());
+
+      // Exercise
+      std::array<can_router::acceptance_filter, 4> filter_storage{};
+      auto const filters = router->acceptance_filters(filter_storage);
+
+      // Verify
+      expect(that % 1 == filters.size());
+      expect(that % 0 == filters[0].mask);
+
+      // Exercise
+      router->clear_unrouted();
+      router->operator()(can::message_t{ .id = 0x102 });
+
+      // Verify
+      expect(that % 1 == unrouted_counter);
+      expect(that % 3 == router->unrouted_count());
+    }
+  };
+
+  "can_router::on_unrouted() deferred"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can::message_t, 4> queue_storage{};
+    can_message_queue queue(queue_storage);
+    can_router router(mock);
+    int immediate_counter = 0;
+    int deferred_counter = 0;
+    router.defer_dispatch(&queue);
+    auto routed = router.add_message_callback(
+      0x100, [&](const can::message_t&) { deferred_counter++; });
+
+    // Exercise
+    router.on_unrouted([&](const can::message_t&) { deferred_counter++; });
+    router(can::message_t{ .id = 0x200 });
+
+    // Verify
+    expect(that % 0 == deferred_counter);
+    expect(that % 1 == queue.size());
+
+    // Exercise
+    expect(that % 1 == router.poll());
+
+    // Verify
+    expect(that % 1 == deferred_counter);
+
+    // Exercise
+    router.on_unrouted([&](const can::message_t&) { immediate_counter++; },
+                       can_router::dispatch_mode::immediate);
+    router(can::message_t{ .id = 0x200 });
+
+    // Verify
+    expect(that % 1 == immediate_counter);
+    expect(that % 0 == queue.size());
+    expect(that % 2 == router.unrouted_count());
+  };
+
+  "can_router::allow_live_updates()"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can_router::index_entry, 4> index_storage{};
+    std::array<can_router::index_entry, 4> spare_storage{};
+    std::array<can_router::index_entry, 3> small_storage{};
+    can_router::standard_id_table standard_table{};
+    can_router linear_router(mock);
+    can_router router(mock, index_storage, standard_table);
+    std::array<int, 3> counter{};
+
+    // Exercise & Verify
+    expect(throws<hal::argument_out_of_domain>(
+      [&]() { linear_router.allow_live_updates(spare_storage); }));
+    expect(throws<hal::argument_out_of_domain>(
+      [&]() { router.allow_live_updates(small_storage); }));
+
+    // Exercise
+    router.allow_live_updates(spare_storage);
+    auto const* first_buffer = router.index().data();
+    auto status = router.add_message_callback(
+      0x200, [&](const can::message_t&) { counter[0]++; });
+    auto const* second_buffer = router.index().data();
+    auto extended = router.add_message_callback(
+      0x1234'5678, [&](const can::message_t&) { counter[1]++; });
+    auto block = std::make_optional(router.add_message_callback(
+      can_router::id_range{ .first = 0x100, .last = 0x1FF },
+      [&](const can::message_t&) { counter[2]++; }));
+
+    // Verify
+    expect(first_buffer != second_buffer);
+    expect(first_buffer == index_storage.data() ||
+           first_buffer == spare_storage.data());
+    expect(second_buffer == index_storage.data() ||
+           second_buffer == spare_storage.data());
+    expect(that % 2 == router.index().size());
+
+    // Exercise
+    auto early = std::make_optional(router.add_message_callback(
+      0x100, [&](const can::message_t&) { counter[2] += 10; }));
+    router(can::message_t{ .id = 0x100 });
+    early.reset();
+    block.reset();
+    router(can::message_t{ .id = 0x100 });
+    router(can::message_t{ .id = 0x200 });
+    router(can::message_t{ .id = 0x1234'5678 });
+
+    // Verify
+    expect(that % 1 == counter[0]);
+    expect(that % 1 == counter[1]);
+    expect(that % 11 == counter[2]);
+    expect(that % 2 == router.index().size());
+    expect(that % 0x200 == router.index()[0].id);
+    expect(that % 0x1234'5678 == router.index()[1].id);
+  };
+
+  "can_router::attach()"_test = []() {
+    // Setup
+    mock_can first_bus;
+    mock_can second_bus;
+    std::array<can_router::index_entry, 4> index_storage{};
+    can_router router(first_bus, index_storage);
+    std::array<int, 2> counter{};
+    std::array<std::uint8_t, 2> source{};
+    std::array<can_router::acceptance_filter, 2> filters{};
+
+    // Exercise
+    auto const second = router.attach(second_bus);
+    auto any = router.add_message_callback(
+      0x100, [&](const can::message_t&) {
+        source[0] = router.source_bus();
+        counter[0]++;
+      });
+    auto only_second = router.add_route({
+      .id = 0x100,
+      .handler =
+        [&](const can::message_t&) {
+          source[1] = router.source_bus();
+          counter[1]++;
+        },
+      .bus = second,
+    });
+    auto second_status = router.add_route({ .id = 0x300, .bus = second });
+    first_bus.m_handler(can::message_t{ .id = 0x100 });
+
+    // Verify
+    expect(that % 1 == second);
+    expect(that % 2 == router.bus_count());
+    expect(&second_bus == &router.bus(second));
+    expect(that % 1 == counter[0]);
+    expect(that % 0 == counter[1]);
+    expect(that % 0 == source[0]);
+    expect(that % 0 == router.unrouted_count());
+
+    // Exercise
+    second_bus.m_handler(can::message_t{ .id = 0x100 });
+
+    // Verify
+    expect(that % 2 == counter[0]);
+    expect(that % 1 == counter[1]);
+    expect(that % 1 == source[0]);
+    expect(that % 1 == source[1]);
+    expect(that % 1 == router.acceptance_filters(filters, 0).size());
+    expect(that % 2 == router.acceptance_filters(filters, second).size());
+    expect(throws<hal::argument_out_of_domain>(
+      [&]() { [[maybe_unused]] auto& bus = router.bus(2); }));
+    expect(throws<hal::argument_out_of_domain>([&]() {
+      [[maybe_unused]] auto item = router.add_route({ .bus = 7 });
+    }));
+  };
+
+  "can_router::poll() multiple buses"_test = []() {
+    // Setup
+    mock_can first_bus;
+    mock_can second_bus;
+    std::array<can::message_t, 4> first_storage{};
+    std::array<can::message_t, 4> second_storage{};
+    can_message_queue first_queue(first_storage);
+    can_message_queue second_queue(second_storage);
+    can_router router(first_bus);
+    auto const second = router.attach(second_bus);
+    std::array<std::uint8_t, 4> sources{};
+    std::size_t received = 0;
+    router.defer_dispatch(&first_queue);
+    router.defer_dispatch(&second_queue, second);
+    auto route = router.add_message_callback(
+      0x100, [&](const can::message_t&) {
+        sources[received++] = router.source_bus();
+      });
+
+    // Exercise
+    first_bus.m_handler(can::message_t{ .id = 0x100 });
+    first_bus.m_handler(can::message_t{ .id = 0x100 });
+    second_bus.m_handler(can::message_t{ .id = 0x100 });
+
+    // Verify
+    expect(that % 0 == received);
+    expect(that % 2 == first_queue.size());
+    expect(that % 1 == second_queue.size());
+
+    // Exercise
+    expect(that % 3 == router.poll());
+
+    // Verify
+    expect(that % 3 == received);
+    expect(that % 0 == sources[0]);
+    expect(that % 1 == sources[1]);
+    expect(that % 0 == sources[2]);
+    expect(throws<hal::argument_out_of_domain>(
+      [&]() { router.defer_dispatch(&first_queue, 2); }));
+  };
+
+  "can_router::poll_context()"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can::message_t, 4> main_storage{};
+    std::array<can::message_t, 4> worker_storage{};
+    can_message_queue main_queue(main_storage);
+    can_message_queue worker_queue(worker_storage);
+    std::array<can_router::index_entry, 4> index_storage{};
+    can_router router(mock, index_storage);
+    int main_runs = 0;
+    int worker_runs = 0;
+    int unqueued_runs = 0;
+    router.defer_dispatch(&main_queue);
+    router.defer_dispatch(&worker_queue, 0, 1);
+    auto on_main = router.add_message_callback(
+      0x100, [&](const can::message_t&) { main_runs++; });
+    auto on_worker = router.add_route({
+      .id = 0x100,
+      .handler = [&](const can::message_t&) { worker_runs++; },
+      .context = 1,
+    });
+    auto second_on_worker = router.add_route({
+      .id = 0x100,
+      .handler = [&](const can::message_t&) { worker_runs++; },
+      .context = 1,
+    });
+    auto on_unqueued = router.add_route({
+      .id = 0x200,
+      .handler = [&](const can::message_t&) { unqueued_runs++; },
+      .context = 2,
+    });
+
+    // Exercise
+    mock.m_handler(can::message_t{ .id = 0x100 });
+    mock.m_handler(can::message_t{ .id = 0x200 });
+
+    // Verify
+    expect(that % 1 == main_queue.size());
+    expect(that % 1 == worker_queue.size());
+    expect(that % 1 == unqueued_runs);
+
+    // Exercise
+    expect(that % 1 == router.poll_context(1));
+
+    // Verify
+    expect(that % 0 == main_runs);
+    expect(that % 2 == worker_runs);
+    expect(that % 0 == router.source_bus(1));
+
+    // Exercise
+    expect(that % 1 == router.poll());
+
+    // Verify
+    expect(that % 1 == main_runs);
+    expect(that % 2 == worker_runs);
+    expect(that % 0 == router.poll_context(4));
+    expect(throws<hal::argument_out_of_domain>(
+      [&]() { router.defer_dispatch(&worker_queue, 0, 4); }));
+    expect(throws<hal::argument_out_of_domain>([&]() {
+      auto invalid = router.add_route({ .id = 0x300, .context = 4 });
+    }));
+  };
+
+#if LIBHAL_CANROUTER_INSTRUMENTATION
+  "can_router::statistics()"_test = []() {
+    // Setup
+    mock_can mock;
+    mock_steady_clock clock;
+    std::array<can_router::index_entry, 4> index_storage{};
+    can_router router(mock, index_storage);
+    std::uint64_t handler_duration = 0;
+    router.instrument(&clock);
+
+    auto timed = router.add_message_callback(
+      0x100,
+      [&](const can::message_t&) { clock.m_uptime += handler_duration; });
+
+    // Exercise
+    clock.m_uptime = 1000;
+    handler_duration = 30;
+    router(can::message_t{ .id = 0x100 });
+    clock.m_uptime = 2000;
+    handler_duration = 10;
+    router(can::message_t{ .id = 0x100 });
+    router(can::message_t{ .id = 0x200 });
+
+    // Verify
+    auto const& statistics = timed.get().statistics;
+    expect(that % 2 == statistics.hits);
+    expect(that % 2000 == statistics.last_received);
+    expect(that % 10 == statistics.min_duration);
+    expect(that % 30 == statistics.max_duration);
+    expect(that % 40 == statistics.total_duration);
+    expect(that % 3 == router.statistics().received);
+    expect(that % 1 == router.statistics().misses);
+
+    // Exercise
+    router.reset_statistics();
+
+    // Verify
+    expect(that % 0 == timed.get().statistics.hits);
+    expect(that % 0 == timed.get().statistics.total_duration);
+    expect(that % 0 == router.statistics().received);
+    expect(that % 0 == router.statistics().misses);
+  };
+#endif
 };
 }  // namespace hal
\ No newline at end of file
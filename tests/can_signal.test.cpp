@@ -0,0 +1,94 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-canrouter/can_signal.hpp>
+
+#include <cstdint>
+#include <functional>
+
+#include <libhal-canrouter/can_router.hpp>
+#include <libhal/functional.hpp>
+
+#include <boost/ut.hpp>
+
+#include "helpers.hpp"
+
+namespace hal {
+namespace {
+struct motor_status
+{
+  float speed = 0.0f;
+  std::int16_t current = 0;
+  std::uint8_t fault = 0;
+  bool enabled = false;
+};
+
+using motor_status_layout = can_message_layout<
+  motor_status,
+  can_field<&motor_status::speed,
+            can_signal{ .start = 0, .length = 16, .scale = 0.5 }>,
+  can_field<&motor_status::current,
+            can_signal{ .start = 16, .length = 12, .is_signed = true }>,
+  can_field<&motor_status::enabled, can_signal{ .start = 63 }>>;
+
+constexpr can::message_t motor_frame{
+  .id = 0x120,
+  .payload = { 0x34, 0x12, 0xFE, 0x0F, 0x00, 0x00, 0x00, 0x80 },
+  .length = 8,
+};
+
+constexpr can_signal big_endian_word{
+  .start = 7,
+  .length = 16,
+  .order = can_byte_order::big_endian,
+};
+constexpr can_signal big_endian_nibble{
+  .start = 11,
+  .length = 4,
+  .order = can_byte_order::big_endian,
+};
+
+static_assert(can_signal_raw<can_signal{ .length = 16 }>(motor_frame) ==
+              0x1234);
+static_assert(can_signal_raw<big_endian_word>(motor_frame) == 0x3412);
+static_assert(can_signal_raw<big_endian_nibble>(motor_frame) == 0x2);
+static_assert(motor_status_layout::decode(motor_frame).speed == 2330.0f);
+static_assert(motor_status_layout::decode(motor_frame).current == -2);
+static_assert(motor_status_layout::decode(motor_frame).enabled);
+}  // namespace
+
+void can_signal_test()
+{
+  using namespace boost::ut;
+
+  "can_decoder::operator()"_test = []() {
+    // Setup
+    mock_can mock;
+    can_router router(mock);
+    motor_status received{};
+    can_decoder<motor_status_layout> decoder(
+      [&](const motor_status& p_status) { received = p_status; });
+    auto route = router.add_message_callback(0x120, std::ref(decoder));
+
+    // Exercise
+    mock.m_handler(motor_frame);
+
+    // Verify
+    expect(that % 2330.0f == received.speed);
+    expect(that % -2 == received.current);
+    expect(that % 0 == received.fault);
+    expect(received.enabled);
+  };
+};
+}  // namespace hal
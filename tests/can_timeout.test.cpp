@@ -0,0 +1,129 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-canrouter/can_timeout.hpp>
+
+#include <array>
+#include <optional>
+
+#include <libhal-canrouter/can_router.hpp>
+#include <libhal/error.hpp>
+#include <libhal/functional.hpp>
+
+#include <boost/ut.hpp>
+
+#include "helpers.hpp"
+
+namespace hal {
+void can_timeout_test()
+{
+  using namespace boost::ut;
+
+  "can_timeout_wheel::can_timeout_wheel() invalid slots"_test = []() {
+    std::array<can_timeout*, 6> slots{};
+    expect(throws<hal::argument_out_of_domain>(
+      [&]() { can_timeout_wheel wheel(slots); }));
+  };
+
+  "can_router::add_timeout()"_test = []() {
+    // Setup
+    mock_can mock;
+    can_router router(mock);
+    std::array<can_timeout*, 4> slots{};
+    can_timeout_wheel wheel(slots);
+    int heartbeat_lost = 0;
+    int status_lost = 0;
+    can_timeout heartbeat(wheel, 3, [&]() { heartbeat_lost++; });
+    auto status =
+      std::make_optional<can_timeout>(wheel, 10, [&]() { status_lost++; });
+    auto heartbeat_route = router.add_timeout(0x700, heartbeat);
+
+    // Exercise
+    for (int i = 0; i < 6; i++) {
+      mock.m_handler(can::message_t{ .id = 0x700 });
+      wheel.tick();
+    }
+
+    // Verify
+    expect(that % 0 == heartbeat_lost);
+    expect(not heartbeat.expired());
+
+    // Exercise
+    for (int i = 0; i < 6; i++) {
+      wheel.tick();
+    }
+
+    // Verify
+    expect(that % 1 == heartbeat_lost);
+    expect(that % 1 == status_lost);
+    expect(heartbeat.expired());
+
+    // Exercise
+    status.reset();
+    mock.m_handler(can::message_t{ .id = 0x700 });
+    for (int i = 0; i < 2; i++) {
+      wheel.tick();
+    }
+
+    // Verify
+    expect(not heartbeat.expired());
+
+    // Exercise
+    for (int i = 0; i < 20; i++) {
+      wheel.tick();
+    }
+
+    // Verify
+    expect(that % 2 == heartbeat_lost);
+    expect(that % 1 == status_lost);
+    expect(that % 34 == wheel.now());
+  };
+
+  "can_timeout::restart()"_test = []() {
+    // Setup
+    std::array<can_timeout*, 4> slots{};
+    can_timeout_wheel wheel(slots);
+    int first_lost = 0;
+    int second_lost = 0;
+    std::optional<can_timeout> first;
+    std::optional<can_timeout> second;
+    // Constructed second, so it is visited first and the other is pending
+    second.emplace(wheel, 4, [&]() { second_lost++; });
+    first.emplace(wheel, 4, [&]() {
+      first_lost++;
+      first->restart(wheel.now());
+      second.reset();
+    });
+
+    // Exercise
+    for (int i = 0; i < 4; i++) {
+      wheel.tick();
+    }
+
+    // Verify
+    expect(that % 1 == first_lost);
+    expect(that % 0 == second_lost);
+    expect(not first->expired());
+    expect(not second.has_value());
+
+    // Exercise
+    for (int i = 0; i < 4; i++) {
+      wheel.tick();
+    }
+
+    // Verify
+    expect(that % 2 == first_lost);
+  };
+};
+}  // namespace hal
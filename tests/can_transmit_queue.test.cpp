@@ -0,0 +1,128 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-canrouter/can_transmit_queue.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include <libhal/error.hpp>
+#include <libhal/functional.hpp>
+
+#include <boost/ut.hpp>
+
+#include "helpers.hpp"
+
+namespace hal {
+void can_transmit_queue_test()
+{
+  using namespace boost::ut;
+
+  "can_transmit_queue::can_transmit_queue() empty storage"_test = []() {
+    mock_can mock;
+    expect(throws<hal::argument_out_of_domain>([&]() {
+      can_transmit_queue queue(mock, std::span<can::message_t>{});
+    }));
+  };
+
+  "can_transmit_queue::send() & drain()"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can::message_t, 4> storage{};
+    can_transmit_queue queue(mock, storage);
+    mock.m_free_mailboxes = 3;
+
+    // Exercise
+    queue.send(can::message_t{ .id = 0x300, .payload = { 1 } });
+    queue.send(can::message_t{ .id = 0x0800'0000, .payload = { 2 } });
+    queue.send(can::message_t{ .id = 0x100, .payload = { 3 } });
+    queue.send(can::message_t{ .id = 0x300, .payload = { 4 } });
+    queue.send(can::message_t{ .id = 0x001, .payload = { 5 } });
+    bool const accepted = queue.send(can::message_t{ .id = 0x002 });
+
+    // Verify
+    expect(not accepted);
+    expect(that % 4 == queue.size());
+    expect(that % 1 == queue.coalesced_count());
+    expect(that % 1 == queue.overflow_count());
+
+    // Exercise
+    auto const first_batch = queue.drain();
+
+    // Verify
+    expect(that % 3 == first_batch);
+    expect(that % 1 == queue.size());
+    expect(that % 0x001 == mock.m_sent[0].id);
+    expect(that % 0x100 == mock.m_sent[1].id);
+    // An extended ID with a base ID of 0x200 wins over standard ID 0x300
+    expect(that % 0x0800'0000 == mock.m_sent[2].id);
+
+    // Exercise
+    mock.m_free_mailboxes = 3;
+    auto const second_batch = queue.drain();
+
+    // Verify
+    expect(that % 1 == second_batch);
+    expect(that % 0 == queue.size());
+    expect(that % 0x300 == mock.m_sent[3].id);
+    expect(that % 4 == mock.m_sent[3].payload[0]);
+  };
+
+  "can_transmit_queue::drain() from inside send()"_test = []() {
+    // Setup
+    mock_can mock;
+    std::array<can::message_t, 4> storage{};
+    can_transmit_queue* interrupted = nullptr;
+    bool raise_interrupt = false;
+    int depth = 0;
+    int max_depth = 0;
+    bool transmit_complete = false;
+    std::size_t drained_in_send = 0;
+    // Masks the transmit complete "interrupt" while held and takes it when
+    // released, as the hardware would
+    auto const mask = [&](bool p_enter) {
+      depth += p_enter ? 1 : -1;
+      max_depth = std::max(max_depth, depth);
+      if (p_enter && raise_interrupt) {
+        raise_interrupt = false;
+        transmit_complete = true;
+      }
+      if (depth == 0 && transmit_complete) {
+        transmit_complete = false;
+        drained_in_send += interrupted->drain();
+      }
+    };
+    can_transmit_queue queue(mock, storage, mask);
+    queue.send(can::message_t{ .id = 0x300, .payload = { 1 } });
+    interrupted = &queue;
+    raise_interrupt = true;
+
+    // Exercise
+    bool const accepted =
+      queue.send(can::message_t{ .id = 0x100, .payload = { 2 } });
+
+    // Verify
+    expect(accepted);
+    expect(that % 0 == depth);
+    expect(that % 1 == max_depth);
+    expect(that % 2 == drained_in_send);
+    expect(that % 0 == queue.size());
+    expect(that % 2 == mock.m_sent.size());
+    expect(that % 0x100 == mock.m_sent[0].id);
+    expect(that % 0x300 == mock.m_sent[1].id);
+  };
+};
+}  // namespace hal
@@ -0,0 +1,105 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include <libhal/can.hpp>
+#include <libhal/error.hpp>
+#include <libhal/functional.hpp>
+#include <libhal/steady_clock.hpp>
+#include <libhal/units.hpp>
+
+namespace hal {
+/// CAN driver recording what the library does with it, for the tests and the
+/// benchmark
+class mock_can : public hal::can
+{
+public:
+  std::function<handler> m_handler{};
+  settings m_settings{};
+  /// Last message given to send(), even if the send failed
+  message_t m_message{};
+  /// Messages sent successfully, oldest first
+  std::vector<message_t> m_sent{};
+  /// Sends accepted before every transmit mailbox is full
+  std::size_t m_free_mailboxes = std::numeric_limits<std::size_t>::max();
+  /// Rejects every send as busy while set
+  bool m_busy = false;
+  /// Makes configure() and send() fail with an unrecoverable error
+  bool m_return_error_status = false;
+  std::size_t m_on_receive_call_count = 0;
+
+private:
+  void driver_configure(const settings& p_settings) override
+  {
+    m_settings = p_settings;
+    if (m_return_error_status) {
+      hal::safe_throw(hal::operation_not_supported(this));
+    }
+  }
+
+  void driver_bus_on() override
+  {
+  }
+
+  void driver_send(const message_t& p_message) override
+  {
+    m_message = p_message;
+    if (m_return_error_status) {
+      hal::safe_throw(hal::unknown(this));
+    }
+    if (m_busy || m_free_mailboxes == 0) {
+      hal::safe_throw(hal::resource_unavailable_try_again(this));
+    }
+    m_free_mailboxes--;
+    m_sent.push_back(p_message);
+  }
+
+  void driver_on_receive(hal::callback<handler> p_handler) override
+  {
+    m_on_receive_call_count++;
+    m_handler = p_handler;
+  }
+};
+
+/// Steady clock whose uptime is set by the test
+class mock_steady_clock : public hal::steady_clock
+{
+public:
+  std::uint64_t m_uptime = 0;
+  /// Added to m_uptime after every read, to let time pass on its own
+  std::uint64_t m_step = 0;
+  /// Uptime returned by the last read
+  std::uint64_t m_last_read = 0;
+
+private:
+  hertz driver_frequency() override
+  {
+    return 1.0_MHz;
+  }
+
+  std::uint64_t driver_uptime() override
+  {
+    m_last_read = m_uptime;
+    m_uptime += m_step;
+    return m_last_read;
+  }
+};
+}  // namespace hal
@@ -13,10 +13,40 @@
 // limitations under the License.
 
 namespace hal {
+extern void can_capture_test();
+extern void can_forwarder_test();
+extern void can_frame_test();
+extern void can_handler_ref_test();
+extern void can_isotp_test();
+extern void can_mailbox_test();
+extern void can_message_queue_test();
+extern void can_mux_test();
+extern void can_receiver_test();
+extern void can_replay_test();
+extern void can_route_policy_test();
 extern void can_router_test();
+extern void can_signal_test();
+extern void can_timeout_test();
+extern void can_transmit_queue_test();
+extern void static_can_router_test();
 }  // namespace hal
 
 int main()
 {
+  hal::can_capture_test();
+  hal::can_forwarder_test();
+  hal::can_frame_test();
+  hal::can_handler_ref_test();
+  hal::can_isotp_test();
+  hal::can_mailbox_test();
+  hal::can_message_queue_test();
+  hal::can_mux_test();
+  hal::can_receiver_test();
+  hal::can_replay_test();
+  hal::can_route_policy_test();
   hal::can_router_test();
+  hal::can_signal_test();
+  hal::can_timeout_test();
+  hal::can_transmit_queue_test();
+  hal::static_can_router_test();
 }
\ No newline at end of file
@@ -0,0 +1,135 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-canrouter/static_can_router.hpp>
+
+#include <libhal-util/can.hpp>
+#include <libhal/functional.hpp>
+
+#include <boost/ut.hpp>
+
+#include "helpers.hpp"
+
+namespace hal {
+namespace {
+constexpr std::array<hal::can::id_t, 6> hash_test_ids{
+  0x100, 0x101, 0x102, 0x7FF, 0x1FFF'FFFF, 0x0,
+};
+constexpr auto hash_test = make_can_perfect_hash(hash_test_ids);
+static_assert(hash_test.valid);
+static_assert(hash_test.table_size >= hash_test_ids.size());
+
+constexpr std::array<hal::can::id_t, 3> duplicate_test_ids{ 0x10, 0x20, 0x10 };
+static_assert(not make_can_perfect_hash(duplicate_test_ids).valid);
+
+// Routes hold only an ID and a handler, so none of the can_router::route
+// fields the static router would ignore can be given
+template<class Route>
+concept configurable_route = requires(Route p_route) {
+  p_route.mask;
+  p_route.range;
+  p_route.dispatch;
+  p_route.bus;
+  p_route.policy;
+  p_route.frame_handler;
+};
+static_assert(configurable_route<can_router::route>);
+static_assert(not configurable_route<static_can_router<0x10>::route>);
+}  // namespace
+
+void static_can_router_test()
+{
+  using namespace boost::ut;
+
+  "make_can_perfect_hash() is collision free"_test = []() {
+    // Setup
+    std::array<bool, hash_test.table_size> occupied{};
+
+    // Exercise & Verify
+    for (std::size_t i = 0; i < hash_test_ids.size(); i++) {
+      auto const slot = hash_test.slot(hash_test_ids[i]);
+      expect(slot < occupied.size());
+      expect(not occupied[slot]);
+      expect(that % i == hash_test.find(hash_test_ids[i])->route);
+      occupied[slot] = true;
+    }
+    expect(nullptr == hash_test.find(0x103));
+    expect(nullptr == hash_test.find(UINT32_MAX));
+  };
+
+  "static_can_router::operator()"_test = []() {
+    // Setup
+    mock_can mock;
+    static_can_router<0x100, 0x120, 0x1234'5678> router(mock);
+    int counter1 = 0;
+    int counter2 = 0;
+    can::message_t actual{};
+    static constexpr can::message_t expected1{
+      .id = 0x100,
+      .payload = { 0xAA, 0xBB },
+      .length = 2,
+    };
+    static constexpr can::message_t expected2{
+      .id = 0x1234'5678,
+      .payload = { 0xCC, 0xDD },
+      .length = 2,
+    };
+
+    router.get<0x100>().handler = [&counter1](const can::message_t&) {
+      counter1++;
+    };
+    router.get<0x1234'5678>().handler =
+      [&counter2, &actual](const can::message_t& p_message) {
+        counter2++;
+        actual = p_message;
+      };
+
+    // Exercise
+    mock.m_handler(expected1);
+    mock.m_handler(expected2);
+    mock.m_handler(can::message_t{ .id = 0x120 });
+    mock.m_handler(can::message_t{ .id = 0x121 });
+
+    // Verify
+    expect(that % 1 == counter1);
+    expect(that % 1 == counter2);
+    expect(expected2 == actual);
+    expect(that % 0x120 == router.routes()[1].id);
+  };
+
+  "static_can_router::find()"_test = []() {
+    // Setup
+    mock_can mock;
+    static_can_router<0x10, 0x20, 0x30> router(mock);
+
+    // Exercise & Verify
+    expect(&router.get<0x20>() == router.find(0x20));
+    expect(nullptr == router.find(0x40));
+    expect(nullptr == router.find(UINT32_MAX));
+  };
+
+  "static_can_router::~static_can_router()"_test = []() {
+    // Setup
+    mock_can mock;
+    {
+      static_can_router<0x10> router(mock);
+      auto moved_router = std::move(router);
+      expect(that % 2 == mock.m_on_receive_call_count);
+    }
+
+    // Verify
+    expect(that % 3 == mock.m_on_receive_call_count);
+  };
+};
+}  // namespace hal